@@ -0,0 +1,730 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include "bifurcation.h"
+#include "orbit.h"
+
+/* Orbit is sampled by blocks, so scratch does not grow with x_points */
+#define BIFURCATION_BLOCK       (1024)
+/* First block with cycle detection, doubled up to BIFURCATION_BLOCK */
+#define BIFURCATION_CYCLE_BLOCK (64)
+/* Shortest transient of warm started lanes */
+#define BIFURCATION_SETTLE_BLOCK (64)
+/* Settled lanes are this fraction of eps_abs away from their attractor */
+#define BIFURCATION_SETTLE_FRACTION (0.125)
+/* Candidate period has to repeat for this many steps to be confirmed */
+#define CYCLE_CONFIRM_STEPS     (64)
+
+/*
+ * Growable attractor points of one lane. First unique points are sorted
+ * and at least eps_abs apart, the rest are raw samples waiting for the
+ * next sort-and-unique pass.
+ */
+typedef struct lane_points_s
+{
+    double * data;
+    size_t   count;
+    size_t   unique;
+    size_t   capacity;
+} lane_points_t;
+
+/*
+ * Brent cycle detection with tolerance. saved is compared with every new
+ * point and replaced when lam reaches power, which doubles. A return to
+ * saved after lam steps makes lam a candidate period. It is confirmed
+ * when the orbit keeps returning after exactly lam steps at least twice
+ * and for CYCLE_CONFIRM_STEPS, so a close return of a chaotic orbit does
+ * not stop sampling.
+ */
+typedef struct cycle_s
+{
+    double saved;
+    size_t power;
+    size_t lam;
+    size_t candidate;
+    size_t laps;
+    size_t period;
+} cycle_t;
+
+/* Scratch buffers owned by one thread */
+typedef struct bifurcation_scratch_s
+{
+    double        samples[BIFURCATION_BLOCK * ORBIT_LANES];
+    lane_points_t lanes[ORBIT_LANES];
+} bifurcation_scratch_t;
+
+/*
+ * Workers take chunks in order and put them into slots of a ring, the
+ * calling thread consumes slots in the same order. A worker waits while
+ * its chunk would overwrite a slot that is not consumed yet, so memory
+ * stays bounded by the number of slots.
+ */
+typedef struct bifurcation_pool_s
+{
+    const bifurcation_t * bifurcation;
+    pthread_mutex_t       lock;
+    pthread_cond_t        ready;
+    pthread_cond_t        space;
+    size_t                chunks;
+    size_t                next;
+    size_t                consumed;
+    size_t                slots_count;
+    bifurcation_chunk_t * slots;
+    int *                 done;
+    int                   error;
+} bifurcation_pool_t;
+
+bifurcation_t * bifurcation_alloc(size_t r_points, size_t x_points,
+                                  double eps_abs)
+{
+    bifurcation_t * bifurcation = NULL;
+    double r = 0, r_step;
+    size_t i;
+
+    if (r_points == 0)
+    {
+        fprintf(stderr, "Error: number of \'r\' values should be positive.\n");
+        goto done;
+    }
+
+    bifurcation = calloc(1, sizeof(bifurcation_t));
+    if (bifurcation == NULL)
+    {
+        goto done;
+    }
+
+    bifurcation->r = malloc(r_points * sizeof(double));
+    if (bifurcation->r == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate %lu \'r\' values.\n",
+                (unsigned long)r_points);
+        bifurcation_free(bifurcation);
+        bifurcation = NULL;
+        goto done;
+    }
+
+    bifurcation->r_points = r_points;
+    bifurcation->x_points = x_points;
+    bifurcation->transient = x_points * 100;
+    bifurcation->eps_abs = eps_abs;
+    bifurcation->map = orbit_maps;
+
+    r_step = 1.0 / r_points;
+    for (i = 0; i < r_points; ++i, r += r_step)
+    {
+        bifurcation->r[i] = r;
+    }
+done:
+    return bifurcation;
+}
+
+void bifurcation_free(bifurcation_t * bifurcation)
+{
+    if (bifurcation == NULL)
+    {
+        return;
+    }
+
+    free(bifurcation->r);
+    free(bifurcation);
+}
+
+static int chunk_reserve(bifurcation_chunk_t * chunk, size_t extra)
+{
+    if (chunk->points_count + extra > chunk->points_capacity)
+    {
+        size_t capacity = 2 * chunk->points_capacity + extra;
+        double * points = realloc(chunk->points, capacity * sizeof(double));
+        if (points == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        chunk->points = points;
+        chunk->points_capacity = capacity;
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Image column of r[i] */
+static size_t bifurcation_column(const bifurcation_t * bifurcation, size_t i)
+{
+    return i * bifurcation->width / bifurcation->r_points;
+}
+
+/* Counts samples of lane of r[chunk->first + index] in its image column */
+static void chunk_histogram_add(const bifurcation_t * bifurcation,
+                                bifurcation_chunk_t * chunk, size_t index,
+                                const double * samples, size_t lane_index,
+                                size_t steps)
+{
+    const orbit_map_t * map = bifurcation->map;
+    size_t column = bifurcation_column(bifurcation, chunk->first + index) -
+                    chunk->column;
+    double scale = (double)bifurcation->height / (map->x_max - map->x_min);
+    size_t j, bin;
+
+    for (j = 0; j < steps; ++j)
+    {
+        double x = samples[j * ORBIT_LANES + lane_index];
+        if (!(x >= map->x_min && x < map->x_max))
+        {
+            continue;
+        }
+        bin = (size_t)((x - map->x_min) * scale);
+        bin = (bin < bifurcation->height ? bin : bifurcation->height - 1);
+        chunk->histogram[(bifurcation->height - 1 - bin) * chunk->columns +
+                         column] += 1;
+    }
+}
+
+static int compare_points(const void * a, const void * b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Sorts points and drops every point closer than eps_abs to the previous
+ * kept one, O(K log K)
+ */
+static void lane_unique(lane_points_t * lane, double eps_abs)
+{
+    size_t j, K = 0;
+
+    qsort(lane->data, lane->count, sizeof(double), compare_points);
+    for (j = 0; j < lane->count; ++j)
+    {
+        if (K == 0 || lane->data[j] - lane->data[K - 1] >= eps_abs)
+        {
+            lane->data[K++] = lane->data[j];
+        }
+    }
+    lane->count = lane->unique = K;
+}
+
+static int lane_reserve(lane_points_t * lane, size_t count)
+{
+    if (lane->count + count > lane->capacity)
+    {
+        size_t capacity = 2 * lane->capacity + count;
+        double * data = realloc(lane->data, capacity * sizeof(double));
+        if (data == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        lane->data = data;
+        lane->capacity = capacity;
+    }
+    return EXIT_SUCCESS;
+}
+
+static int lane_append(lane_points_t * lane, const double * samples,
+                       size_t lane_index, size_t steps, double eps_abs)
+{
+    size_t j;
+
+    if (EXIT_SUCCESS != lane_reserve(lane, steps))
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (j = 0; j < steps; ++j)
+    {
+        lane->data[lane->count++] = samples[j * ORBIT_LANES + lane_index];
+    }
+
+    /* Raw tail is deduplicated once it outgrows the unique part */
+    if (lane->count - lane->unique >= lane->unique &&
+        lane->count - lane->unique >= BIFURCATION_BLOCK)
+    {
+        lane_unique(lane, eps_abs);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Replaces collected points with period points of the cycle through x, y */
+static int lane_cycle(lane_points_t * lane, const orbit_map_t * map,
+                      double r, double x, double y, size_t period)
+{
+    size_t k;
+
+    lane->count = lane->unique = 0;
+    if (EXIT_SUCCESS != lane_reserve(lane, period))
+    {
+        return EXIT_FAILURE;
+    }
+    for (k = 0; k < period; ++k)
+    {
+        lane->data[lane->count++] = x;
+        map->step(r, &x, &y);
+    }
+    return EXIT_SUCCESS;
+}
+
+static void cycle_start(cycle_t * cycle, double x)
+{
+    cycle->saved = x;
+    cycle->power = 1;
+    cycle->lam = 0;
+    cycle->candidate = 0;
+    cycle->laps = 0;
+    cycle->period = 0;
+}
+
+/* Stops at the sample that confirmed a period */
+static void cycle_feed(cycle_t * cycle, const double * samples,
+                       size_t lane_index, size_t steps, double eps_abs)
+{
+    size_t j;
+
+    for (j = 0; j < steps; ++j)
+    {
+        double x = samples[j * ORBIT_LANES + lane_index];
+
+        ++cycle->lam;
+        if (fabs(x - cycle->saved) < eps_abs)
+        {
+            if (cycle->lam == cycle->candidate)
+            {
+                ++cycle->laps;
+                if (cycle->laps >= 2 &&
+                    cycle->laps * cycle->lam >= CYCLE_CONFIRM_STEPS)
+                {
+                    cycle->period = cycle->lam;
+                    return;
+                }
+            }
+            else
+            {
+                cycle->candidate = cycle->lam;
+                cycle->laps = 0;
+            }
+            cycle->saved = x;
+            cycle->lam = 0;
+            continue;
+        }
+
+        if (cycle->lam == cycle->candidate)
+        {
+            cycle->candidate = 0;
+        }
+        if (cycle->lam == cycle->power)
+        {
+            cycle->saved = x;
+            cycle->power *= 2;
+            cycle->lam = 0;
+        }
+    }
+}
+
+static size_t gcd(size_t a, size_t b)
+{
+    while (b != 0)
+    {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Starts lanes from x0, y0 of map and runs the full transient */
+static void bifurcation_cold(const bifurcation_t * bifurcation,
+                             const double r_lanes[ORBIT_LANES],
+                             double x_lanes[ORBIT_LANES],
+                             double y_lanes[ORBIT_LANES])
+{
+    const orbit_map_t * map = bifurcation->map;
+    size_t l;
+
+    for (l = 0; l < ORBIT_LANES; ++l)
+    {
+        x_lanes[l] = map->x0;
+        y_lanes[l] = map->y0;
+    }
+    map->iterate(r_lanes, x_lanes, y_lanes, bifurcation->transient);
+}
+
+/*
+ * Transient for warm started lanes, previous lanes gave sizes attractor
+ * points and Lyapunov exponents lyapunov. Lanes are compared one stride
+ * apart, where stride is a multiple of every periodic size, so differences
+ * of an orbit converging to a cycle of the same period or twice it, when
+ * it divides stride, decay geometrically by some q. Lane is settled when
+ * the remaining distance d * q / (1 - q) is well below eps_abs. A small d
+ * alone proves nothing: a state inherited from r where 0 or the old cycle
+ * was stable sits on a fixed point that is unstable at the new r. So every
+ * stride also has to shrink the tangent vector, otherwise lanes restart
+ * cold. Lanes after chaotic ones may enter a periodic window through a
+ * long intermittent transient, so they start cold too, as do lanes that
+ * do not settle within the transient. Warm start thus only shortens
+ * transient and never changes the attractor a lane ends up on.
+ */
+static void bifurcation_settle(const bifurcation_t * bifurcation,
+                               bifurcation_scratch_t * scratch,
+                               const size_t * sizes, const double * lyapunov,
+                               const double r_lanes[ORBIT_LANES],
+                               double x_lanes[ORBIT_LANES],
+                               double y_lanes[ORBIT_LANES], size_t lanes)
+{
+    double previous[ORBIT_LANES], d_previous[ORBIT_LANES];
+    double log_slope[ORBIT_LANES];
+    double d, q, eps_abs = BIFURCATION_SETTLE_FRACTION * bifurcation->eps_abs;
+    size_t l, steps, settled, stride = 1;
+
+    for (l = 0; l < lanes; ++l)
+    {
+        d_previous[l] = -1;
+        stride = stride / gcd(stride, sizes[l]) * sizes[l];
+        if (lyapunov[l] > 0 || stride > BIFURCATION_BLOCK)
+        {
+            bifurcation_cold(bifurcation, r_lanes, x_lanes, y_lanes);
+            return;
+        }
+    }
+    stride *= (BIFURCATION_SETTLE_BLOCK + stride - 1) / stride;
+
+    for (steps = 0; steps < bifurcation->transient; steps += stride)
+    {
+        memcpy(previous, x_lanes, sizeof(previous));
+        memset(log_slope, 0, sizeof(log_slope));
+        bifurcation->map->sample(r_lanes, x_lanes, y_lanes, stride,
+                                 scratch->samples, log_slope);
+
+        for (l = 0, settled = 0; l < lanes; ++l)
+        {
+            if (!(log_slope[l] < 0))
+            {
+                bifurcation_cold(bifurcation, r_lanes, x_lanes, y_lanes);
+                return;
+            }
+            d = fabs(x_lanes[l] - previous[l]);
+            q = (d_previous[l] > 0 ? d / d_previous[l] : 1);
+            if (d == 0 || (q < 1 && d * q < eps_abs * (1 - q)))
+            {
+                ++settled;
+            }
+            d_previous[l] = d;
+        }
+        if (settled == lanes)
+        {
+            return;
+        }
+    }
+    bifurcation_cold(bifurcation, r_lanes, x_lanes, y_lanes);
+}
+
+static int bifurcation_chunk(const bifurcation_t * bifurcation,
+                             bifurcation_scratch_t * scratch,
+                             bifurcation_chunk_t * chunk)
+{
+    double r_lanes[ORBIT_LANES], x_lanes[ORBIT_LANES], y_lanes[ORBIT_LANES];
+    double log_slope[ORBIT_LANES];
+    const orbit_map_t * map = bifurcation->map;
+    cycle_t cycles[ORBIT_LANES];
+    size_t i, l, lanes, active, K, block, steps, remaining, sampled;
+
+    chunk->points_count = 0;
+    if (bifurcation->width > 0)
+    {
+        chunk->column = bifurcation_column(bifurcation, chunk->first);
+        chunk->columns = bifurcation_column(bifurcation, chunk->first +
+                                            chunk->count - 1) -
+                         chunk->column + 1;
+        memset(chunk->histogram, 0,
+               chunk->columns * bifurcation->height * sizeof(size_t));
+    }
+    for (i = 0; i < chunk->count; i += ORBIT_LANES)
+    {
+        lanes = (chunk->count - i < ORBIT_LANES ?
+                 chunk->count - i : ORBIT_LANES);
+        for (l = 0; l < ORBIT_LANES; ++l)
+        {
+            r_lanes[l] = bifurcation->r[chunk->first + i +
+                                        (l < lanes ? l : lanes - 1)];
+            log_slope[l] = 0;
+        }
+
+        if (bifurcation->warm && i > 0)
+        {
+            bifurcation_settle(bifurcation, scratch,
+                               chunk->sizes + i - ORBIT_LANES,
+                               chunk->lyapunov + i - ORBIT_LANES, r_lanes,
+                               x_lanes, y_lanes, lanes);
+        }
+        else
+        {
+            bifurcation_cold(bifurcation, r_lanes, x_lanes, y_lanes);
+        }
+
+        /* State after transient is the first attractor point */
+        for (l = 0; l < lanes; ++l)
+        {
+            cycle_start(&cycles[l], x_lanes[l]);
+            scratch->lanes[l].count = scratch->lanes[l].unique = 0;
+            if (EXIT_SUCCESS != lane_append(&scratch->lanes[l], x_lanes, l,
+                                            1, bifurcation->eps_abs))
+            {
+                return EXIT_FAILURE;
+            }
+        }
+
+        /* Lanes stop together once every periodic lane is confirmed */
+        active = lanes;
+        sampled = 0;
+        block = (bifurcation->cycles ?
+                 BIFURCATION_CYCLE_BLOCK : BIFURCATION_BLOCK);
+        for (remaining = bifurcation->x_points; remaining > 0 && active > 0;
+             remaining -= steps)
+        {
+            steps = (remaining < block ? remaining : block);
+            map->sample(r_lanes, x_lanes, y_lanes, steps, scratch->samples,
+                        log_slope);
+            sampled += steps;
+            for (l = 0; l < lanes; ++l)
+            {
+                if (bifurcation->width > 0)
+                {
+                    chunk_histogram_add(bifurcation, chunk, i + l,
+                                        scratch->samples, l, steps);
+                }
+                if (cycles[l].period != 0)
+                {
+                    continue;
+                }
+                if (EXIT_SUCCESS != lane_append(&scratch->lanes[l],
+                                                scratch->samples, l, steps,
+                                                bifurcation->eps_abs))
+                {
+                    return EXIT_FAILURE;
+                }
+                if (!bifurcation->cycles)
+                {
+                    continue;
+                }
+
+                /* Lane state at the end of block is on the cycle too */
+                cycle_feed(&cycles[l], scratch->samples, l, steps,
+                           bifurcation->eps_abs);
+                if (cycles[l].period != 0)
+                {
+                    --active;
+                    if (EXIT_SUCCESS != lane_cycle(&scratch->lanes[l], map,
+                            r_lanes[l], x_lanes[l], y_lanes[l],
+                            cycles[l].period))
+                    {
+                        return EXIT_FAILURE;
+                    }
+                }
+            }
+            block = (block < BIFURCATION_BLOCK ? 2 * block : block);
+        }
+
+        for (l = 0; l < lanes; ++l)
+        {
+            lane_points_t * lane = &scratch->lanes[l];
+
+            lane_unique(lane, bifurcation->eps_abs);
+            K = lane->count;
+            if (EXIT_SUCCESS != chunk_reserve(chunk, K))
+            {
+                return EXIT_FAILURE;
+            }
+            memcpy(chunk->points + chunk->points_count, lane->data,
+                   K * sizeof(double));
+            chunk->points_count += K;
+            chunk->sizes[i + l] = K;
+            chunk->lyapunov[i + l] = (sampled > 0 ?
+                log_slope[l] / (double)sampled : 0);
+            chunk->periods[i + l] = cycles[l].period;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+static void * bifurcation_worker(void * arg)
+{
+    bifurcation_pool_t * pool = arg;
+    const bifurcation_t * bifurcation = pool->bifurcation;
+    bifurcation_scratch_t * scratch = calloc(1, sizeof(bifurcation_scratch_t));
+    size_t l;
+    int retval;
+
+    for (;;)
+    {
+        size_t c;
+        bifurcation_chunk_t * chunk;
+
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->error && pool->next < pool->chunks &&
+               pool->next >= pool->consumed + pool->slots_count)
+        {
+            pthread_cond_wait(&pool->space, &pool->lock);
+        }
+        if (pool->error || pool->next >= pool->chunks)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        c = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        chunk = &pool->slots[c % pool->slots_count];
+        chunk->first = c * BIFURCATION_CHUNK;
+        chunk->count = bifurcation->r_points - chunk->first;
+        if (chunk->count > BIFURCATION_CHUNK)
+        {
+            chunk->count = BIFURCATION_CHUNK;
+        }
+
+        retval = EXIT_FAILURE;
+        if (scratch != NULL)
+        {
+            retval = bifurcation_chunk(bifurcation, scratch, chunk);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (retval != EXIT_SUCCESS)
+        {
+            fprintf(stderr, "Error: could not allocate orbit samples.\n");
+            pool->error = 1;
+            /* Workers waiting for a free slot have to see the error too */
+            pthread_cond_broadcast(&pool->space);
+        }
+        pool->done[c % pool->slots_count] = 1;
+        pthread_cond_broadcast(&pool->ready);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    for (l = 0; scratch != NULL && l < ORBIT_LANES; ++l)
+    {
+        free(scratch->lanes[l].data);
+    }
+    free(scratch);
+    return NULL;
+}
+
+/*
+ * Computes the diagram with threads workers and hands chunks to consume in
+ * r order, so output is the same as of a serial run
+ */
+int bifurcation_run(const bifurcation_t * bifurcation, size_t threads,
+                    chunk_cb consume, void * params)
+{
+    int retval = EXIT_SUCCESS;
+    size_t c, t, started = 0, histogram_size;
+    pthread_t * workers = NULL;
+    bifurcation_pool_t pool;
+
+    memset(&pool, 0, sizeof(pool));
+    if (bifurcation == NULL || consume == NULL || threads == 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    pool.bifurcation = bifurcation;
+    pool.chunks = (bifurcation->r_points + BIFURCATION_CHUNK - 1) /
+                  BIFURCATION_CHUNK;
+    pool.slots_count = 2 * threads;
+    pool.slots = calloc(pool.slots_count, sizeof(bifurcation_chunk_t));
+    pool.done = calloc(pool.slots_count, sizeof(int));
+    workers = malloc(threads * sizeof(pthread_t));
+    if (pool.slots == NULL || pool.done == NULL || workers == NULL)
+    {
+        retval = EXIT_FAILURE;
+        goto done;
+    }
+
+    /* Chunk spans at most this many image columns */
+    histogram_size = (BIFURCATION_CHUNK * bifurcation->width /
+                      bifurcation->r_points + 2) * bifurcation->height;
+    for (c = 0; c < pool.slots_count && bifurcation->width > 0; ++c)
+    {
+        pool.slots[c].histogram = malloc(histogram_size * sizeof(size_t));
+        if (pool.slots[c].histogram == NULL)
+        {
+            fprintf(stderr, "Error: could not allocate image of %lu x %lu.\n",
+                    (unsigned long)bifurcation->width,
+                    (unsigned long)bifurcation->height);
+            retval = EXIT_FAILURE;
+            goto done;
+        }
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.ready, NULL);
+    pthread_cond_init(&pool.space, NULL);
+
+    for (started = 0; started < threads; ++started)
+    {
+        if (0 != pthread_create(&workers[started], NULL, bifurcation_worker,
+                                &pool))
+        {
+            fprintf(stderr, "Error: could not start bifurcation thread.\n");
+            break;
+        }
+    }
+
+    for (c = 0; c < pool.chunks && started > 0; ++c)
+    {
+        size_t slot = c % pool.slots_count;
+
+        pthread_mutex_lock(&pool.lock);
+        while (!pool.done[slot] && !pool.error)
+        {
+            pthread_cond_wait(&pool.ready, &pool.lock);
+        }
+        retval = (pool.error ? EXIT_FAILURE : EXIT_SUCCESS);
+        pthread_mutex_unlock(&pool.lock);
+        if (retval != EXIT_SUCCESS)
+        {
+            break;
+        }
+
+        retval = consume(bifurcation, &pool.slots[slot], params);
+
+        pthread_mutex_lock(&pool.lock);
+        pool.done[slot] = 0;
+        ++pool.consumed;
+        if (retval != EXIT_SUCCESS)
+        {
+            pool.error = 1;
+        }
+        pthread_cond_broadcast(&pool.space);
+        pthread_mutex_unlock(&pool.lock);
+        if (retval != EXIT_SUCCESS)
+        {
+            break;
+        }
+    }
+
+    for (t = 0; t < started; ++t)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    if (started == 0 || pool.error)
+    {
+        retval = EXIT_FAILURE;
+    }
+
+    pthread_cond_destroy(&pool.space);
+    pthread_cond_destroy(&pool.ready);
+    pthread_mutex_destroy(&pool.lock);
+done:
+    if (pool.slots != NULL)
+    {
+        for (c = 0; c < pool.slots_count; ++c)
+        {
+            free(pool.slots[c].points);
+            free(pool.slots[c].histogram);
+        }
+    }
+    free(pool.slots);
+    free(pool.done);
+    free(workers);
+    return retval;
+}
@@ -0,0 +1,66 @@
+#ifndef BIFURCATION_H
+#define BIFURCATION_H
+
+#include <stddef.h>
+
+#include "orbit.h"
+
+#define BIFURCATION_CHUNK       (256)
+
+/*
+ * Bifurcation diagram of map over r_points values of r. r[i] is accumulated
+ * the same way a serial loop does it, so results do not depend on the number
+ * of threads. With cycles set every r stops sampling as soon as its orbit is
+ * confirmed periodic. With warm set lanes continue from final states of the
+ * previous r values of the chunk and transient stops once they converge.
+ * Nonzero width and height make chunks count samples on a width x height grid
+ * over r in [0, 1] and x in [x_min, x_max] of map.
+ */
+typedef struct bifurcation_s
+{
+    size_t   r_points;
+    size_t   x_points;
+    size_t   transient;
+    double   eps_abs;
+    int      cycles;
+    int      warm;
+    const orbit_map_t * map;
+    size_t   width;
+    size_t   height;
+    double * r;
+} bifurcation_t;
+
+/*
+ * Result for BIFURCATION_CHUNK consecutive r values starting at first.
+ * sizes[i] attractor points of r[first + i] follow each other in points,
+ * lyapunov[i] is mean log|f'(x)| over the sampled orbit of r[first + i],
+ * periods[i] is its detected period or 0. histogram holds height rows of
+ * columns sample counts for image columns from column on, row 0 is x_max.
+ */
+typedef struct bifurcation_chunk_s
+{
+    size_t   first;
+    size_t   count;
+    size_t   sizes[BIFURCATION_CHUNK];
+    double   lyapunov[BIFURCATION_CHUNK];
+    size_t   periods[BIFURCATION_CHUNK];
+    double * points;
+    size_t   points_count;
+    size_t   points_capacity;
+    size_t * histogram;
+    size_t   column;
+    size_t   columns;
+} bifurcation_chunk_t;
+
+/* Receives chunks in r order in the calling thread */
+typedef int (*chunk_cb)(const bifurcation_t * bifurcation,
+                        const bifurcation_chunk_t * chunk, void * params);
+
+bifurcation_t * bifurcation_alloc(size_t r_points, size_t x_points,
+                                  double eps_abs);
+void bifurcation_free(bifurcation_t * bifurcation);
+
+int bifurcation_run(const bifurcation_t * bifurcation, size_t threads,
+                    chunk_cb consume, void * params);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef DD_H
+#define DD_H
+
+/*
+ * Double-double arithmetic. A value is an unevaluated sum hi + lo with
+ * |lo| <= ulp(hi) / 2, which gives about 106 bits. Macros work on plain
+ * double lvalues, so they vectorize inside lane loops. Results may alias
+ * arguments, temporaries are prefixed with dd_.
+ */
+
+#define DD_EPSILON              (4.93038065763132e-32)
+
+/* Splits 53 bit mantissa into two 26 bit halves, 2^27 + 1 */
+#define DD_SPLITTER             (134217729.0)
+
+/* s + e == a + b exactly */
+#define DD_TWO_SUM(a, b, s, e) \
+    { \
+        double dd_a = (a), dd_b = (b), dd_v; \
+        s = dd_a + dd_b; \
+        dd_v = (s) - dd_a; \
+        e = (dd_a - ((s) - dd_v)) + (dd_b - dd_v); \
+    }
+
+/* Same as DD_TWO_SUM when |a| >= |b| */
+#define DD_QUICK_TWO_SUM(a, b, s, e) \
+    { \
+        double dd_a = (a), dd_b = (b); \
+        s = dd_a + dd_b; \
+        e = dd_b - ((s) - dd_a); \
+    }
+
+/*
+ * p + e == a * b exactly. Targets with FMA, e.g. ARCH_FLAGS = -march=native,
+ * get the error term in one instruction, others use Dekker splitting.
+ */
+#ifdef __FP_FAST_FMA
+#define DD_TWO_PROD(a, b, p, e) \
+    { \
+        double dd_a = (a), dd_b = (b); \
+        p = dd_a * dd_b; \
+        e = __builtin_fma(dd_a, dd_b, -(p)); \
+    }
+#else
+#define DD_TWO_PROD(a, b, p, e) \
+    { \
+        double dd_a = (a), dd_b = (b), dd_t, dd_ah, dd_al, dd_bh, dd_bl; \
+        dd_t = DD_SPLITTER * dd_a; \
+        dd_ah = dd_t - (dd_t - dd_a); \
+        dd_al = dd_a - dd_ah; \
+        dd_t = DD_SPLITTER * dd_b; \
+        dd_bh = dd_t - (dd_t - dd_b); \
+        dd_bl = dd_b - dd_bh; \
+        p = dd_a * dd_b; \
+        e = ((dd_ah * dd_bh - (p)) + dd_ah * dd_bl + dd_al * dd_bh) + \
+            dd_al * dd_bl; \
+    }
+#endif
+
+/* (ch, cl) = (ah, al) + (bh, bl) */
+#define DD_ADD(ah, al, bh, bl, ch, cl) \
+    { \
+        double dd_sh, dd_sl, dd_th, dd_tl; \
+        DD_TWO_SUM(ah, bh, dd_sh, dd_sl); \
+        DD_TWO_SUM(al, bl, dd_th, dd_tl); \
+        dd_sl += dd_th; \
+        DD_QUICK_TWO_SUM(dd_sh, dd_sl, dd_sh, dd_sl); \
+        dd_sl += dd_tl; \
+        DD_QUICK_TWO_SUM(dd_sh, dd_sl, ch, cl); \
+    }
+
+/* (ch, cl) = (ah, al) * (bh, bl) */
+#define DD_MUL(ah, al, bh, bl, ch, cl) \
+    { \
+        double dd_ph, dd_pl, dd_cross = (ah) * (bl) + (al) * (bh); \
+        DD_TWO_PROD(ah, bh, dd_ph, dd_pl); \
+        dd_pl += dd_cross; \
+        DD_QUICK_TWO_SUM(dd_ph, dd_pl, ch, cl); \
+    }
+
+/* (ch, cl) = (ah, al) * b */
+#define DD_MUL_D(ah, al, b, ch, cl) \
+    { \
+        double dd_ph, dd_pl, dd_cross = (al) * (b); \
+        DD_TWO_PROD(ah, b, dd_ph, dd_pl); \
+        dd_pl += dd_cross; \
+        DD_QUICK_TWO_SUM(dd_ph, dd_pl, ch, cl); \
+    }
+
+/* (xh, xl) = 4 * (rh, rl) * (xh, xl) * (1 - (xh, xl)) */
+#define DD_LOGISTIC_STEP(rh, rl, xh, xl) \
+    { \
+        double dd_oh, dd_ol, dd_qh, dd_ql; \
+        DD_ADD(1.0, 0.0, -(xh), -(xl), dd_oh, dd_ol); \
+        DD_MUL(xh, xl, dd_oh, dd_ol, dd_qh, dd_ql); \
+        DD_MUL(dd_qh, dd_ql, 4.0 * (rh), 4.0 * (rl), xh, xl); \
+    }
+
+#endif
@@ -0,0 +1,159 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dd.h"
+#include "feigenbaum.h"
+#include "orbit.h"
+
+#define FEIGENBAUM_DELTA_SEED   (4.669)
+#define FEIGENBAUM_MAX_NEWTON   (32)
+#define FEIGENBAUM_TOLERANCE    (4 * DBL_EPSILON)
+#define FEIGENBAUM_TOLERANCE_DD (4 * DD_EPSILON)
+
+/* Returns f^period(1/2) - 1/2, its r derivative goes to dr */
+static double superstable_residual(double r, size_t period, double * dr)
+{
+    double x = 0.5, dx = 0;
+    size_t k;
+
+    for (k = 0; k < period; ++k)
+    {
+        dx = 4.0 * x * (1.0 - x) + 4.0 * r * (1.0 - 2.0 * x) * dx;
+        x = LOGISTIC_STEP(r, x);
+    }
+    if (dr != NULL)
+    {
+        *dr = dx;
+    }
+    return x - 0.5;
+}
+
+/* Same as superstable_residual with r = rh + rl in double-double */
+static double superstable_residual_dd(double rh, double rl, size_t period,
+                                      double * dr)
+{
+    double xh = 0.5, xl = 0, dx = 0, gh, gl;
+    size_t k;
+
+    for (k = 0; k < period; ++k)
+    {
+        dx = 4.0 * xh * (1.0 - xh) + 4.0 * rh * (1.0 - 2.0 * xh) * dx;
+        DD_LOGISTIC_STEP(rh, rl, xh, xl);
+    }
+    if (dr != NULL)
+    {
+        *dr = dx;
+    }
+    DD_ADD(xh, xl, -0.5, 0.0, gh, gl);
+    return gh + gl;
+}
+
+/*
+ * Newton iteration on r = rh + rl, returns EXIT_FAILURE when it does not
+ * converge. Derivative only scales the step, so it is kept in double.
+ */
+static int superstable_newton(double * rh, double * rl, size_t period,
+                              int precision)
+{
+    double g, dg, step, tolerance;
+    size_t i;
+
+    tolerance = (precision == FEIGENBAUM_DOUBLE_DOUBLE ?
+                 FEIGENBAUM_TOLERANCE_DD : FEIGENBAUM_TOLERANCE);
+    for (i = 0; i < FEIGENBAUM_MAX_NEWTON; ++i)
+    {
+        if (precision == FEIGENBAUM_DOUBLE_DOUBLE)
+        {
+            g = superstable_residual_dd(*rh, *rl, period, &dg);
+            step = g / dg;
+            DD_ADD(*rh, *rl, -step, 0.0, *rh, *rl);
+        }
+        else
+        {
+            g = superstable_residual(*rh, period, &dg);
+            step = g / dg;
+            *rh -= step;
+        }
+        if (fabs(step) <= tolerance * *rh)
+        {
+            return EXIT_SUCCESS;
+        }
+    }
+    return EXIT_FAILURE;
+}
+
+/* Returns r[a] - r[b] including low parts */
+static double level_spacing(const feigenbaum_t * feigenbaum, size_t a,
+                            size_t b)
+{
+    double h, l;
+
+    DD_ADD(feigenbaum->r[a], feigenbaum->r_low[a], -feigenbaum->r[b],
+           -feigenbaum->r_low[b], h, l);
+    return h + l;
+}
+
+/*
+ * Level n is seeded by r[n - 1] + (r[n - 1] - r[n - 2]) / delta[n - 1], so
+ * Newton starts well inside the basin of r[n] and not of earlier levels,
+ * which are roots too. Stops early when spacing of levels drops below what
+ * the chosen precision resolves and Newton no longer converges. Levels are
+ * differenced in double-double, so delta keeps full double accuracy.
+ */
+int feigenbaum_run(feigenbaum_t * feigenbaum, size_t levels, int precision)
+{
+    double delta = FEIGENBAUM_DELTA_SEED, rh, rl, d;
+    size_t n;
+
+    if (feigenbaum == NULL || levels < 2 || levels > FEIGENBAUM_MAX_LEVELS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    memset(feigenbaum, 0, sizeof(feigenbaum_t));
+    feigenbaum->r[0] = 0.5;
+    feigenbaum->r[1] = (1.0 + sqrt(5.0)) / 4.0;
+    if (EXIT_SUCCESS != superstable_newton(&feigenbaum->r[1],
+                                           &feigenbaum->r_low[1], 2,
+                                           precision))
+    {
+        return EXIT_FAILURE;
+    }
+    /* f(1/2) = r */
+    feigenbaum->d[1] = (feigenbaum->r[1] - 0.5) + feigenbaum->r_low[1];
+    feigenbaum->levels = 2;
+
+    for (n = 2; n < levels; ++n)
+    {
+        rh = feigenbaum->r[n - 1];
+        rl = feigenbaum->r_low[n - 1];
+        DD_ADD(rh, rl, level_spacing(feigenbaum, n - 1, n - 2) / delta, 0.0,
+               rh, rl);
+        if (precision != FEIGENBAUM_DOUBLE_DOUBLE)
+        {
+            rh += rl;
+            rl = 0;
+        }
+        if (EXIT_SUCCESS != superstable_newton(&rh, &rl, (size_t)1 << n,
+                                               precision) ||
+            rh <= feigenbaum->r[n - 1])
+        {
+            break;
+        }
+
+        feigenbaum->r[n] = rh;
+        feigenbaum->r_low[n] = rl;
+        d = (precision == FEIGENBAUM_DOUBLE_DOUBLE ?
+             superstable_residual_dd(rh, rl, (size_t)1 << (n - 1), NULL) :
+             superstable_residual(rh, (size_t)1 << (n - 1), NULL));
+        feigenbaum->d[n] = d;
+        delta = level_spacing(feigenbaum, n - 1, n - 2) /
+                level_spacing(feigenbaum, n, n - 1);
+        feigenbaum->delta[n] = delta;
+        feigenbaum->alpha[n] = feigenbaum->d[n - 1] / feigenbaum->d[n];
+        feigenbaum->levels = n + 1;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,30 @@
+#ifndef FEIGENBAUM_H
+#define FEIGENBAUM_H
+
+#include <stddef.h>
+
+#define FEIGENBAUM_MAX_LEVELS   (32)
+
+#define FEIGENBAUM_DOUBLE       (0)
+#define FEIGENBAUM_DOUBLE_DOUBLE (1)
+
+/*
+ * Superstable parameters r[n] + r_low[n] of period 2^n, where the orbit
+ * of x = 1/2 returns to 1/2, r_low[n] is nonzero in double-double only.
+ * d[n] is distance from 1/2 to the orbit point half period later, delta[n]
+ * and alpha[n] are estimates of Feigenbaum constants from levels up to n,
+ * defined for n >= 2.
+ */
+typedef struct feigenbaum_s
+{
+    size_t levels;
+    double r[FEIGENBAUM_MAX_LEVELS];
+    double r_low[FEIGENBAUM_MAX_LEVELS];
+    double d[FEIGENBAUM_MAX_LEVELS];
+    double delta[FEIGENBAUM_MAX_LEVELS];
+    double alpha[FEIGENBAUM_MAX_LEVELS];
+} feigenbaum_t;
+
+int feigenbaum_run(feigenbaum_t * feigenbaum, size_t levels, int precision);
+
+#endif
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #ifdef __linux__
 #define __USE_POSIX2           (1)
@@ -9,38 +10,79 @@
 
 #include <unistd.h>
 
+#include "bifurcation.h"
+#include "feigenbaum.h"
+
 #define UNUSED(x) (void)(x)
-#define MAX_POINTS_AT_R_STEP    (4096)
+#define MAX_DIVISION_POINTS     (64)
 
 #define DEFAULT_STEP            (1)
 #define MAX_STRING_SIZE         (4096)
-#define OPTIONS                 "a:f:hr:vx:"
+#define OPTIONS                 "a:cf:hi:m:n:p:r:s:t:vwx:H:W:"
 
 #define OPTION_DEFAULT_FILE     "data.dat"
+#define OPTION_DEFAULT_MODE     "bifurcation"
+#define OPTION_DEFAULT_MAP      "logistic"
+#define OPTION_DEFAULT_PRECISION "double"
+
+#define MODE_BIFURCATION        (0)
+#define MODE_FEIGENBAUM         (1)
 
 #define OPTION_DEFAULT_X_POINTS                 (100)
 #define OPTION_DEFAULT_R_POINTS                 (1000)
+#define OPTION_DEFAULT_THREADS                  (1lu)
+#define OPTION_DEFAULT_LEVELS                   (16lu)
+#define OPTION_DEFAULT_WIDTH                    (1024lu)
+#define OPTION_DEFAULT_HEIGHT                   (768lu)
 
 #define OPTION_DEFAULT_AERROR                   (1e-3)
 
-double model_cb(double x[], void *params);
+/* Period doubling search state, filled in r order */
+typedef struct chaos_output_s
+{
+    FILE * division_points;
+    FILE * lyapunov;
+    FILE * periods;
+    size_t * image;
+    size_t prev_len;
+    double div_points[MAX_DIVISION_POINTS];
+    size_t N;
+} chaos_output_t;
 
 void print_usage();
 
-int make_chaos(size_t x_points, size_t r_points, double eps_abs);
+int write_chunk(const bifurcation_t * bifurcation,
+                const bifurcation_chunk_t * chunk, void * params);
+int make_chaos(size_t x_points, size_t r_points, double eps_abs,
+               size_t threads, int cycles, int warm,
+               const orbit_map_t * map, const char * image_name,
+               size_t width, size_t height);
+int write_image(const char * image_name, const size_t * image, size_t width,
+                size_t height);
+int find_feigenbaum(size_t levels, int precision);
 
 int main(int argc, char *const * argv)
 {
     int retval = EXIT_SUCCESS;
     char option = 0;
     int verbose = 0;
+    int cycles = 0;
+    int warm = 0;
+    const orbit_map_t * map = orbit_map_find(OPTION_DEFAULT_MAP);
+    int precision = FEIGENBAUM_DOUBLE;
+    int mode = MODE_BIFURCATION;
 
     char file_name[MAX_STRING_SIZE] = OPTION_DEFAULT_FILE;
+    char image_name[MAX_STRING_SIZE] = "";
 
     double eps_abs = OPTION_DEFAULT_AERROR;
 
     size_t r_points = OPTION_DEFAULT_R_POINTS;
     size_t x_points = OPTION_DEFAULT_X_POINTS;
+    size_t threads = OPTION_DEFAULT_THREADS;
+    size_t levels = OPTION_DEFAULT_LEVELS;
+    size_t width = OPTION_DEFAULT_WIDTH;
+    size_t height = OPTION_DEFAULT_HEIGHT;
 
     while ((option = getopt(argc, argv, OPTIONS)) != -1)
     {
@@ -54,6 +96,9 @@ int main(int argc, char *const * argv)
                     goto done;
                 }
             break;
+            case 'c':
+                cycles = 1;
+            break;
             case 'f':
                 strcpy(file_name, optarg);
             break;
@@ -62,6 +107,51 @@ int main(int argc, char *const * argv)
                 retval = EXIT_FAILURE;
                 goto done;
             break;
+            case 'i':
+                strcpy(image_name, optarg);
+            break;
+            case 'm':
+                if (0 == strcmp(optarg, "bifurcation"))
+                {
+                    mode = MODE_BIFURCATION;
+                }
+                else if (0 == strcmp(optarg, "feigenbaum"))
+                {
+                    mode = MODE_FEIGENBAUM;
+                }
+                else
+                {
+                    fprintf(stderr, "Error: bad mode. Should be bifurcation or feigenbaum.\n");
+                    retval = EXIT_FAILURE;
+                    goto done;
+                }
+            break;
+            case 'n':
+                if (1 != sscanf(optarg, "%lu", &levels) || levels < 2 ||
+                    levels > FEIGENBAUM_MAX_LEVELS)
+                {
+                    fprintf(stderr, "Error: bad number of levels. Should be number from 2 to %d.\n",
+                            FEIGENBAUM_MAX_LEVELS);
+                    retval = EXIT_FAILURE;
+                    goto done;
+                }
+            break;
+            case 'p':
+                if (0 == strcmp(optarg, "double"))
+                {
+                    precision = FEIGENBAUM_DOUBLE;
+                }
+                else if (0 == strcmp(optarg, "dd"))
+                {
+                    precision = FEIGENBAUM_DOUBLE_DOUBLE;
+                }
+                else
+                {
+                    fprintf(stderr, "Error: bad precision. Should be double or dd.\n");
+                    retval = EXIT_FAILURE;
+                    goto done;
+                }
+            break;
             case 'r':
                 if (1 != sscanf(optarg, "%lu", &r_points))
                 {
@@ -70,9 +160,29 @@ int main(int argc, char *const * argv)
                     goto done;
                 }
             break;
+            case 's':
+                map = orbit_map_find(optarg);
+                if (map == NULL)
+                {
+                    fprintf(stderr, "Error: bad map. Should be logistic, tent, sine, gauss or henon.\n");
+                    retval = EXIT_FAILURE;
+                    goto done;
+                }
+            break;
+            case 't':
+                if (1 != sscanf(optarg, "%lu", &threads) || threads == 0)
+                {
+                    fprintf(stderr, "Error: bad number of threads. Should be positive number.\n");
+                    retval = EXIT_FAILURE;
+                    goto done;
+                }
+            break;
             case 'v':
                 verbose = 1;
             break;
+            case 'w':
+                warm = 1;
+            break;
             case 'x':
                 if (1 != sscanf(optarg, "%lu", &x_points))
                 {
@@ -81,6 +191,22 @@ int main(int argc, char *const * argv)
                     goto done;
                 }
             break;
+            case 'H':
+                if (1 != sscanf(optarg, "%lu", &height) || height == 0)
+                {
+                    fprintf(stderr, "Error: bad image height. Should be positive number.\n");
+                    retval = EXIT_FAILURE;
+                    goto done;
+                }
+            break;
+            case 'W':
+                if (1 != sscanf(optarg, "%lu", &width) || width == 0)
+                {
+                    fprintf(stderr, "Error: bad image width. Should be positive number.\n");
+                    retval = EXIT_FAILURE;
+                    goto done;
+                }
+            break;
             default:
                 print_usage();
                 retval = EXIT_FAILURE;
@@ -88,11 +214,34 @@ int main(int argc, char *const * argv)
         }
     }
 
+    if (mode == MODE_BIFURCATION && precision == FEIGENBAUM_DOUBLE_DOUBLE)
+    {
+        map = map->dd;
+        if (map == NULL)
+        {
+            fprintf(stderr, "Error: double-double precision supports logistic map only.\n");
+            retval = EXIT_FAILURE;
+            goto done;
+        }
+    }
+
     if (verbose)
     {
         printf("# Absolute error:                       %e\n", eps_abs);
         printf("# Number of \'x\' points:                 %lu\n", x_points);
         printf("# Number of \'r\' points                  %lu\n", r_points);
+        printf("# Map:                                  %s\n", map->name);
+        printf("# Precision:                            %s\n",
+               precision == FEIGENBAUM_DOUBLE_DOUBLE ? "dd" : "double");
+        printf("# Threads:                              %lu\n", threads);
+        printf("# Cycle detection:                      %s\n", cycles ? "on" : "off");
+        printf("# Warm start:                           %s\n", warm ? "on" : "off");
+        printf("# Feigenbaum levels:                    %lu\n", levels);
+        if (image_name[0] != '\0')
+        {
+            printf("# Image:                                %s %lux%lu\n", image_name,
+                   width, height);
+        }
     }
 
     if (stdout != freopen(file_name, "w", stdout))
@@ -102,102 +251,261 @@ int main(int argc, char *const * argv)
         goto done;
     }
 
-    retval = make_chaos(x_points, r_points, eps_abs);
+    if (mode == MODE_FEIGENBAUM && 0 != strcmp(map->name, "logistic"))
+    {
+        fprintf(stderr, "Error: feigenbaum mode supports logistic map only.\n");
+        retval = EXIT_FAILURE;
+        goto done;
+    }
+
+    if (mode == MODE_FEIGENBAUM)
+    {
+        retval = find_feigenbaum(levels, precision);
+    }
+    else
+    {
+        retval = make_chaos(x_points, r_points, eps_abs, threads, cycles,
+                            warm, map, image_name, width, height);
+    }
 done:
     return retval;
 }
 
-int make_chaos(size_t x_points, size_t r_points, double eps_abs)
+/* Receives chunks in r order and looks for period doubling points */
+int write_chunk(const bifurcation_t * bifurcation,
+                const bifurcation_chunk_t * chunk, void * params)
 {
-    FILE * division_points = fopen("div_points.dat", "w");
-    int retval = EXIT_SUCCESS;
-    int prev_len = 1;
-    double current_r_points[MAX_POINTS_AT_R_STEP];
-    double x[2];
-    double r = 0, r_step = 1.0 / r_points;
-    double div_points[MAX_POINTS_AT_R_STEP];
-    double len = 0;
-    double delta = 0;
+    chaos_output_t * output = params;
+    const double * points = chunk->points;
+    size_t i, k, K;
 
-    uint8_t is_div_point = 0;
-    size_t i, j, k, K = 0, N = 0;
-
-    for (i = 0; i < r_points; ++i, r += r_step)
+    for (i = 0; i < chunk->count; ++i, points += K)
     {
-        is_div_point = 0;
-        K = 0;
-        x[0] = x[1] = 0.5;
-
-        for (j = 0; j < x_points * 100; ++j)
+        double r = bifurcation->r[chunk->first + i];
+        K = chunk->sizes[i];
+        fprintf(output->lyapunov, "%e %e\n", r, chunk->lyapunov[i]);
+        if (output->periods != NULL)
         {
-            model_cb(x, (void *)(&r));
-            x[0] = x[1];
+            fprintf(output->periods, "%e %lu\n", r,
+                    (unsigned long)chunk->periods[i]);
         }
-        current_r_points[K++] = x[1];
-        for (j = 0; j < x_points; ++j)
+
+        /* Number of points doubled when K is a bigger power of two */
+        if ((K & (K - 1)) == 0 && K > output->prev_len)
         {
-            double current_point = model_cb(x, (void *)(&r));
-            uint8_t to_add = 1;
-            for (k = 0; k < K; ++k)
+            output->prev_len = K;
+            fprintf(stderr, "%lu %f %f\n", (unsigned long)K, r,
+                    bifurcation->eps_abs);
+            for (k = 1; k < K; k++)
             {
-                if (fabs(current_point - current_r_points[k]) < eps_abs)
-                {
-                    /*
-                     * Then points are close to each other and there is no need
-                     * to add new one
-                     */
-                    to_add = 0;
-                }
+                fprintf(output->division_points, "%e %e\n", r, points[k]);
             }
-            if (to_add)
+            if (output->N < MAX_DIVISION_POINTS)
             {
-                current_r_points[K++] = current_point;
+                output->div_points[output->N++] = r;
             }
-            x[0] = x[1];
         }
-        len = log2(K);
-        is_div_point = (len == ((double)(int)(len)) && K > prev_len);
-        if (is_div_point)
+
+        for (k = 0; k < K && output->image == NULL; ++k)
         {
-            prev_len = K;
-            fprintf(stderr, "%lu %f %f\n", K, r, eps_abs);
-            for (k = 1; k < K; k++)
-            {
-                fprintf(division_points, "%e %e\n", r, current_r_points[k]);
-            }
-            div_points[N++] = r;
+            printf("%e %e\n", r, points[k]);
+        }
+    }
+
+    /* Partial histograms of neighbouring chunks may share a column */
+    for (i = 0; output->image != NULL && i < bifurcation->height; ++i)
+    {
+        size_t * row = output->image + i * bifurcation->width + chunk->column;
+        const size_t * counts = chunk->histogram + i * chunk->columns;
+        for (k = 0; k < chunk->columns; ++k)
+        {
+            row[k] += counts[k];
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int make_chaos(size_t x_points, size_t r_points, double eps_abs,
+               size_t threads, int cycles, int warm,
+               const orbit_map_t * map, const char * image_name,
+               size_t width, size_t height)
+{
+    int retval = EXIT_SUCCESS;
+    bifurcation_t * bifurcation = NULL;
+    chaos_output_t output;
+    double delta = 0;
+    size_t N;
+
+    memset(&output, 0, sizeof(output));
+    output.prev_len = 1;
+    output.division_points = fopen("div_points.dat", "w");
+    output.lyapunov = fopen("lyapunov.dat", "w");
+    output.periods = (cycles ? fopen("periods.dat", "w") : NULL);
+    bifurcation = bifurcation_alloc(r_points, x_points, eps_abs);
+    if (output.division_points == NULL || output.lyapunov == NULL ||
+        (cycles && output.periods == NULL) || bifurcation == NULL)
+    {
+        retval = EXIT_FAILURE;
+        goto done;
+    }
+    bifurcation->cycles = cycles;
+    bifurcation->warm = warm;
+    bifurcation->map = map;
+    if (image_name[0] != '\0')
+    {
+        output.image = calloc(width * height, sizeof(size_t));
+        if (output.image == NULL)
+        {
+            fprintf(stderr, "Error: could not allocate image of %lu x %lu.\n",
+                    (unsigned long)width, (unsigned long)height);
+            retval = EXIT_FAILURE;
+            goto done;
         }
+        bifurcation->width = width;
+        bifurcation->height = height;
+    }
+
+    retval = bifurcation_run(bifurcation, threads, write_chunk, &output);
+    if (retval != EXIT_SUCCESS)
+    {
+        goto done;
+    }
+
+    N = output.N;
+    if (N >= 3)
+    {
+        N -= 1;
+        delta = (output.div_points[N - 1] - output.div_points[N - 2]) /
+                (output.div_points[N] - output.div_points[N - 1]);
+        fprintf(stderr, "Delta: %f\n", delta);
+    }
+
+    if (output.image != NULL)
+    {
+        retval = write_image(image_name, output.image, width, height);
+    }
+done:
+    if (output.division_points != NULL)
+    {
+        fclose(output.division_points);
+    }
+    if (output.lyapunov != NULL)
+    {
+        fclose(output.lyapunov);
+    }
+    if (output.periods != NULL)
+    {
+        fclose(output.periods);
+    }
+    free(output.image);
+    bifurcation_free(bifurcation);
+    return retval;
+}
+
+/*
+ * Writes binary PGM, black on white. Every column is scaled by its own
+ * maximum on log scale, so sparse chaotic bands stay visible next to
+ * periodic orbits.
+ */
+int write_image(const char * image_name, const size_t * image, size_t width,
+                size_t height)
+{
+    int retval = EXIT_SUCCESS;
+    FILE * file = fopen(image_name, "wb");
+    unsigned char * pixels = malloc(width * height);
+    size_t i, j, max;
 
-        for (k = 0; k < K; ++k)
+    if (file == NULL || pixels == NULL)
+    {
+        fprintf(stderr, "Error: could not write image %s\n", image_name);
+        retval = EXIT_FAILURE;
+        goto done;
+    }
+
+    for (j = 0; j < width; ++j)
+    {
+        for (i = 0, max = 0; i < height; ++i)
         {
-            printf("%e %e\n", r, current_r_points[k]);
+            max = (image[i * width + j] > max ? image[i * width + j] : max);
         }
+        for (i = 0; i < height; ++i)
+        {
+            double level = (max > 0 ? log(1.0 + (double)image[i * width + j]) /
+                                      log(1.0 + (double)max) : 0);
+            pixels[i * width + j] = (unsigned char)(255.0 * (1.0 - level) + 0.5);
+        }
+    }
+
+    fprintf(file, "P5\n%lu %lu\n255\n", (unsigned long)width,
+            (unsigned long)height);
+    if (height != fwrite(pixels, width, height, file))
+    {
+        fprintf(stderr, "Error: could not write image %s\n", image_name);
+        retval = EXIT_FAILURE;
     }
-    N -= 1;
-    fclose(division_points);
-    delta = (div_points[N - 1] - div_points[N - 2]) / (div_points[N] - div_points[N - 1]);
-    fprintf(stderr, "Delta: %f\n", delta);
+done:
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    free(pixels);
     return retval;
 }
 
-double model_cb(double x[], void *params)
+/* Writes superstable r of every period 2^n with delta and alpha estimates */
+int find_feigenbaum(size_t levels, int precision)
 {
-    double r = ((double *)params)[0];
+    int retval = EXIT_SUCCESS;
+    feigenbaum_t feigenbaum;
+    size_t n;
+
+    retval = feigenbaum_run(&feigenbaum, levels, precision);
+    if (retval != EXIT_SUCCESS)
+    {
+        goto done;
+    }
 
-    x[1] = 4.0 * r * x[0] * (1.0 - x[0]);
+    for (n = 0; n < feigenbaum.levels; ++n)
+    {
+        printf("%lu %.17e %.17e %.17e\n", (unsigned long)n, feigenbaum.r[n],
+               feigenbaum.delta[n], feigenbaum.alpha[n]);
+    }
 
-    return x[1];
+    n = feigenbaum.levels - 1;
+    if (n < levels - 1)
+    {
+        fprintf(stderr, "Levels: %lu of %lu resolved\n",
+                (unsigned long)feigenbaum.levels, (unsigned long)levels);
+    }
+    if (n >= 2)
+    {
+        fprintf(stderr, "Delta: %.12f\n", feigenbaum.delta[n]);
+        fprintf(stderr, "Alpha: %.12f\n", feigenbaum.alpha[n]);
+    }
+done:
+    return retval;
 }
-/* "a:f:hp:r:t:vA:B:C:D:P:T:" */
+
+/* "a:cf:hi:m:n:p:r:s:t:vwx:H:W:" */
 void print_usage()
 {
     printf("OVERVIEW: Holling-Tanner predator-prey model simulation.\n\n");
     printf("USAGE: holling-tanner [options]\n\n");
     printf("OPTIONS:\n");
     printf("  -a <error>     Absolute error. Default is %e\n", OPTION_DEFAULT_AERROR);
+    printf("  -c             Stop sampling periodic orbits once a cycle is confirmed, write periods.dat\n");
     printf("  -f <file>      Output file. Default is " OPTION_DEFAULT_FILE "\n");
     printf("  -h             Print this message\n");
+    printf("  -i <file>      Write density image to PGM file instead of points\n");
+    printf("  -m <mode>      Mode: bifurcation or feigenbaum. Default is " OPTION_DEFAULT_MODE "\n");
+    printf("  -n <value>     Number of period doubling levels in feigenbaum mode. Default is %lu\n", OPTION_DEFAULT_LEVELS);
+    printf("  -p <value>     Precision: double or dd (double-double). Default is " OPTION_DEFAULT_PRECISION "\n");
     printf("  -r <value>     Number of \'r\' values. Default is %d\n", OPTION_DEFAULT_R_POINTS);
+    printf("  -s <map>       Map: logistic, tent, sine, gauss or henon. Default is " OPTION_DEFAULT_MAP "\n");
+    printf("  -t <value>     Number of threads. Default is %lu\n", OPTION_DEFAULT_THREADS);
     printf("  -v             Verbose mode\n");
-    printf("  -w <value>     Number of \'x\' values. Default is %d\n", OPTION_DEFAULT_X_POINTS);
+    printf("  -w             Start every 'r' from the previous attractor and shorten transient\n");
+    printf("  -x <value>     Number of \'x\' values. Default is %d\n", OPTION_DEFAULT_X_POINTS);
+    printf("  -H <value>     Image height. Default is %lu\n", OPTION_DEFAULT_HEIGHT);
+    printf("  -W <value>     Image width. Default is %lu\n", OPTION_DEFAULT_WIDTH);
 }
@@ -0,0 +1,188 @@
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "dd.h"
+#include "orbit.h"
+
+#define PI                      (3.14159265358979323846)
+
+#define GAUSS_ALPHA             (7.5)
+#define HENON_A(r)              (1.4 * (r))
+#define HENON_B                 (0.3)
+
+/*
+ * Step and tangent macros of every map. Tangent macros advance tangent
+ * vector (u, v) with Jacobian at the state before the step.
+ */
+#define LOGISTIC_MAP(r, x, y)   x = LOGISTIC_STEP(r, x)
+#define LOGISTIC_TANGENT(r, x, y, u, v) \
+    u *= LOGISTIC_SLOPE(r, x)
+
+/* Double-double logistic map, y holds low part of x */
+#define LOGISTIC_DD_MAP(r, x, y) DD_LOGISTIC_STEP(r, 0.0, x, y)
+#define LOGISTIC_DD_TANGENT(r, x, y, u, v) \
+    LOGISTIC_TANGENT(r, x, y, u, v)
+
+#define TENT_MAP(r, x, y)       x = 2.0 * (r) * ((x) < 0.5 ? (x) : 1.0 - (x))
+#define TENT_TANGENT(r, x, y, u, v) \
+    u *= ((x) < 0.5 ? 2.0 * (r) : -2.0 * (r))
+
+#define SINE_MAP(r, x, y)       x = (r) * sin(PI * (x))
+#define SINE_TANGENT(r, x, y, u, v) \
+    u *= PI * (r) * cos(PI * (x))
+
+/* Parameter b = 2r - 1 runs over [-1, 1] */
+#define GAUSS_MAP(r, x, y) \
+    x = exp(-GAUSS_ALPHA * (x) * (x)) + 2.0 * (r) - 1.0
+#define GAUSS_TANGENT(r, x, y, u, v) \
+    u *= -2.0 * GAUSS_ALPHA * (x) * exp(-GAUSS_ALPHA * (x) * (x))
+
+#define HENON_MAP(r, x, y) \
+    { \
+        double x_next = 1.0 - HENON_A(r) * (x) * (x) + (y); \
+        y = HENON_B * (x); \
+        x = x_next; \
+    }
+#define HENON_TANGENT(r, x, y, u, v) \
+    { \
+        double u_next = -2.0 * HENON_A(r) * (x) * (u) + (v); \
+        v = HENON_B * (u); \
+        u = u_next; \
+    }
+
+/*
+ * Generates scalar step and lane kernels of one map. Kernels copy lanes to
+ * locals first, so the compiler sees no aliasing and the inner loop over
+ * lanes becomes a single vector operation.
+ *
+ * sample stores the next steps states of every lane, samples[j *
+ * ORBIT_LANES + l] is x of lane l after j + 1 steps. It adds log of growth
+ * of the tangent vector to log_slope. |f'| of every map is bounded, so
+ * ORBIT_LOG_BLOCK steps cannot overflow and the log is taken once per
+ * block. Two dimensional tangent starts along x on every call, which
+ * aligns with the expanding direction in a few steps.
+ */
+#define ORBIT_KERNELS(name, MAP, TANGENT, DIMENSION) \
+static void name##_step(double r, double * x, double * y) \
+{ \
+    double xs = *x, ys = *y; \
+    MAP(r, xs, ys); \
+    *x = xs; \
+    *y = ys; \
+} \
+\
+static void name##_iterate(const double r[ORBIT_LANES], \
+                           double x[ORBIT_LANES], double y[ORBIT_LANES], \
+                           size_t steps) \
+{ \
+    double rl[ORBIT_LANES], xl[ORBIT_LANES], yl[ORBIT_LANES]; \
+    size_t j, l; \
+\
+    for (l = 0; l < ORBIT_LANES; ++l) \
+    { \
+        rl[l] = r[l]; \
+        xl[l] = x[l]; \
+        yl[l] = y[l]; \
+    } \
+\
+    for (j = 0; j < steps; ++j) \
+    { \
+        for (l = 0; l < ORBIT_LANES; ++l) \
+        { \
+            MAP(rl[l], xl[l], yl[l]); \
+        } \
+    } \
+\
+    for (l = 0; l < ORBIT_LANES; ++l) \
+    { \
+        x[l] = xl[l]; \
+        y[l] = yl[l]; \
+    } \
+} \
+\
+static void name##_sample(const double r[ORBIT_LANES], \
+                          double x[ORBIT_LANES], double y[ORBIT_LANES], \
+                          size_t steps, double * samples, \
+                          double log_slope[ORBIT_LANES]) \
+{ \
+    double rl[ORBIT_LANES], xl[ORBIT_LANES], yl[ORBIT_LANES]; \
+    double u[ORBIT_LANES], v[ORBIT_LANES], norm; \
+    size_t j, l; \
+\
+    for (l = 0; l < ORBIT_LANES; ++l) \
+    { \
+        rl[l] = r[l]; \
+        xl[l] = x[l]; \
+        yl[l] = y[l]; \
+        u[l] = 1.0; \
+        v[l] = 0.0; \
+    } \
+\
+    for (j = 0; j < steps; ++j) \
+    { \
+        for (l = 0; l < ORBIT_LANES; ++l) \
+        { \
+            TANGENT(rl[l], xl[l], yl[l], u[l], v[l]); \
+            MAP(rl[l], xl[l], yl[l]); \
+            samples[j * ORBIT_LANES + l] = xl[l]; \
+        } \
+\
+        if ((j + 1) % ORBIT_LOG_BLOCK == 0 || j + 1 == steps) \
+        { \
+            for (l = 0; l < ORBIT_LANES; ++l) \
+            { \
+                norm = (DIMENSION == 1 ? fabs(u[l]) : \
+                        sqrt(u[l] * u[l] + v[l] * v[l])); \
+                log_slope[l] += log(norm); \
+                u[l] = (DIMENSION == 1 ? 1.0 : u[l] / norm); \
+                v[l] = (DIMENSION == 1 ? 0.0 : v[l] / norm); \
+            } \
+        } \
+    } \
+\
+    for (l = 0; l < ORBIT_LANES; ++l) \
+    { \
+        x[l] = xl[l]; \
+        y[l] = yl[l]; \
+    } \
+}
+
+ORBIT_KERNELS(logistic, LOGISTIC_MAP, LOGISTIC_TANGENT, 1)
+ORBIT_KERNELS(logistic_dd, LOGISTIC_DD_MAP, LOGISTIC_DD_TANGENT, 1)
+ORBIT_KERNELS(tent, TENT_MAP, TENT_TANGENT, 1)
+ORBIT_KERNELS(sine, SINE_MAP, SINE_TANGENT, 1)
+ORBIT_KERNELS(gauss, GAUSS_MAP, GAUSS_TANGENT, 1)
+ORBIT_KERNELS(henon, HENON_MAP, HENON_TANGENT, 2)
+
+#define ORBIT_MAP(name, dimension, x0, y0, x_min, x_max, dd) \
+    { #name, dimension, x0, y0, x_min, x_max, \
+      name##_step, name##_iterate, name##_sample, dd }
+
+/* Double-double kernels are reachable only through dd of their map */
+static const orbit_map_t logistic_dd_map =
+    ORBIT_MAP(logistic_dd, 1, 0.5, 0.0, 0.0, 1.0, NULL);
+
+const orbit_map_t orbit_maps[] =
+{
+    ORBIT_MAP(logistic, 1, 0.5, 0.0, 0.0, 1.0, &logistic_dd_map),
+    ORBIT_MAP(tent, 1, 0.5, 0.0, 0.0, 1.0, NULL),
+    ORBIT_MAP(sine, 1, 0.5, 0.0, 0.0, 1.0, NULL),
+    ORBIT_MAP(gauss, 1, 0.0, 0.0, -1.0, 2.0, NULL),
+    ORBIT_MAP(henon, 2, 0.0, 0.0, -1.5, 1.5, NULL),
+    { NULL, 0, 0.0, 0.0, 0.0, 0.0, NULL, NULL, NULL, NULL }
+};
+
+const orbit_map_t * orbit_map_find(const char * name)
+{
+    const orbit_map_t * map;
+
+    for (map = orbit_maps; map->name != NULL; ++map)
+    {
+        if (0 == strcmp(map->name, name))
+        {
+            return map;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,48 @@
+#ifndef ORBIT_H
+#define ORBIT_H
+
+#include <stddef.h>
+
+/*
+ * Number of r values advanced in lockstep. Lanes are plain arrays, so the
+ * compiler maps them on whatever vector width the target has: 8 doubles
+ * fill one AVX-512 or two AVX2 registers.
+ */
+#define ORBIT_LANES             (8)
+
+/* Slopes are multiplied this many steps before one log is taken */
+#define ORBIT_LOG_BLOCK         (16)
+
+#define LOGISTIC_STEP(r, x)     (4.0 * (r) * (x) * (1.0 - (x)))
+#define LOGISTIC_SLOPE(r, x)    (4.0 * (r) * (1.0 - 2.0 * (x)))
+
+/*
+ * Discrete map with parameter r in [0, 1] scaled to its interesting range,
+ * x stays in [x_min, x_max]. One dimensional maps keep y untouched.
+ * Kernels are generated for every map from its step macro, so the hot
+ * loops have no indirect calls and a map is chosen once per block of steps.
+ */
+typedef struct orbit_map_s
+{
+    const char * name;
+    size_t       dimension;
+    double       x0;
+    double       y0;
+    double       x_min;
+    double       x_max;
+    void (*step)(double r, double * x, double * y);
+    void (*iterate)(const double r[ORBIT_LANES], double x[ORBIT_LANES],
+                    double y[ORBIT_LANES], size_t steps);
+    void (*sample)(const double r[ORBIT_LANES], double x[ORBIT_LANES],
+                   double y[ORBIT_LANES], size_t steps, double * samples,
+                   double log_slope[ORBIT_LANES]);
+    /* Same map in double-double precision or NULL, y holds low part of x */
+    const struct orbit_map_s * dd;
+} orbit_map_t;
+
+/* Registry ends with an entry with NULL name */
+extern const orbit_map_t orbit_maps[];
+
+const orbit_map_t * orbit_map_find(const char * name);
+
+#endif
@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "backbone.h"
+#include "lattice.h"
+
+#define BACKBONE_NONE           (UINT32_MAX)
+
+#define EDGE_UP                 (0)
+#define EDGE_DOWN               (1)
+#define EDGE_LEFT               (2)
+#define EDGE_RIGHT              (3)
+#define EDGE_SOURCE             (4)
+#define EDGE_SINK               (5)
+#define EDGE_DONE               (6)
+
+#define IN_CLUSTER(bb, i, j)    \
+    (((bb)->cluster[(i) * (bb)->row_words + (j) / LATTICE_WORD_BITS] >> \
+      ((j) % LATTICE_WORD_BITS)) & 1)
+
+backbone_t * backbone_alloc(size_t L)
+{
+    backbone_t * backbone = NULL;
+    size_t words, n;
+
+    /* Two virtual terminals get labels n and n + 1 */
+    if (L == 0 || L > SIZE_MAX / L || L * L >= UINT32_MAX - 2)
+    {
+        fprintf(stderr, "Error: bad grid size %lu.\n", (unsigned long)L);
+        goto done;
+    }
+
+    backbone = calloc(1, sizeof(backbone_t));
+    if (backbone == NULL)
+    {
+        goto done;
+    }
+
+    n = L * L;
+    backbone->L = L;
+    backbone->row_words = (L + LATTICE_WORD_BITS - 1) / LATTICE_WORD_BITS;
+    words = backbone->row_words * L;
+
+    backbone->cluster = calloc(words, sizeof(uint64_t));
+    backbone->frontier = calloc(words, sizeof(uint64_t));
+    backbone->next = calloc(words, sizeof(uint64_t));
+    backbone->visited = calloc(words, sizeof(uint64_t));
+    backbone->disc = calloc(n + 2, sizeof(uint32_t));
+    backbone->low = calloc(n + 2, sizeof(uint32_t));
+    backbone->path = calloc(n + 2, sizeof(uint32_t));
+    backbone->block = calloc(n + 2, sizeof(uint32_t));
+    backbone->edge = calloc(n, sizeof(uint8_t));
+
+    if (backbone->cluster == NULL || backbone->frontier == NULL ||
+        backbone->next == NULL || backbone->visited == NULL ||
+        backbone->disc == NULL || backbone->low == NULL ||
+        backbone->path == NULL || backbone->block == NULL ||
+        backbone->edge == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate backbone analysis.\n");
+        backbone_free(backbone);
+        backbone = NULL;
+    }
+done:
+    return backbone;
+}
+
+void backbone_free(backbone_t * backbone)
+{
+    if (backbone == NULL)
+    {
+        return;
+    }
+
+    free(backbone->cluster);
+    free(backbone->frontier);
+    free(backbone->next);
+    free(backbone->visited);
+    free(backbone->disc);
+    free(backbone->low);
+    free(backbone->path);
+    free(backbone->block);
+    free(backbone->edge);
+    free(backbone);
+}
+
+/*
+ * BFS from the whole top row of the cluster. Frontier is kept only in rows
+ * lo..hi, every level spreads it one row up and down and one bit left and
+ * right inside 64-bit words, with carries between neighbouring words.
+ * Returns number of steps to the bottom row. frontier and next are only
+ * swapped locally, both are scratch buffers.
+ */
+static size_t backbone_distance(backbone_t * bb)
+{
+    size_t i, w, lo = 0, hi = 0, level = 0;
+    size_t L = bb->L, words = bb->row_words;
+    uint64_t * frontier = bb->frontier, * next = bb->next, * swap;
+
+    memset(frontier, 0, L * words * sizeof(uint64_t));
+    memset(next, 0, L * words * sizeof(uint64_t));
+    memset(bb->visited, 0, L * words * sizeof(uint64_t));
+    memcpy(frontier, bb->cluster, words * sizeof(uint64_t));
+    memcpy(bb->visited, bb->cluster, words * sizeof(uint64_t));
+
+    for (;;)
+    {
+        size_t first = (lo > 0 ? lo - 1 : 0);
+        size_t last = (hi + 1 < L ? hi + 1 : hi);
+        size_t next_lo = L, next_hi = 0;
+        const uint64_t * bottom = frontier + (L - 1) * words;
+
+        for (w = 0; w < words; ++w)
+        {
+            if (bottom[w] != 0)
+            {
+                return level;
+            }
+        }
+
+        for (i = first; i <= last; ++i)
+        {
+            const uint64_t * row = frontier + i * words;
+            uint64_t * out = next + i * words;
+            uint64_t any = 0;
+
+            for (w = 0; w < words; ++w)
+            {
+                uint64_t x = (row[w] << 1) | (row[w] >> 1);
+                if (w > 0)
+                {
+                    x |= row[w - 1] >> (LATTICE_WORD_BITS - 1);
+                }
+                if (w + 1 < words)
+                {
+                    x |= row[w + 1] << (LATTICE_WORD_BITS - 1);
+                }
+                if (i > 0)
+                {
+                    x |= frontier[(i - 1) * words + w];
+                }
+                if (i + 1 < L)
+                {
+                    x |= frontier[(i + 1) * words + w];
+                }
+
+                x &= bb->cluster[i * words + w] & ~bb->visited[i * words + w];
+                bb->visited[i * words + w] |= x;
+                out[w] = x;
+                any |= x;
+            }
+
+            if (any != 0)
+            {
+                next_lo = (i < next_lo ? i : next_lo);
+                next_hi = i;
+            }
+        }
+
+        /* Old frontier becomes next buffer, clear rows it occupied */
+        memset(frontier + lo * words, 0,
+               (hi - lo + 1) * words * sizeof(uint64_t));
+        swap = frontier;
+        frontier = next;
+        next = swap;
+
+        ++level;
+        if (next_lo == L)
+        {
+            return 0;
+        }
+        lo = next_lo;
+        hi = next_hi;
+    }
+}
+
+/*
+ * Next unseen neighbour of node v in graph of cluster sites plus source
+ * (connected to top row and sink) and sink (connected to bottom row and
+ * source). virtual_edge holds iteration state of the two terminals.
+ */
+static uint32_t backbone_neighbour(backbone_t * bb, uint32_t v,
+                                   size_t * virtual_edge)
+{
+    size_t L = bb->L, n = L * L, i, j;
+
+    if (v >= n)
+    {
+        size_t * k = &virtual_edge[v - n];
+        uint32_t other = (v == n ? n + 1 : n);
+        i = (v == n ? 0 : L - 1);
+
+        if (*k == 0)
+        {
+            ++*k;
+            return other;
+        }
+        for (; *k <= L; ++*k)
+        {
+            j = *k - 1;
+            if (IN_CLUSTER(bb, i, j))
+            {
+                ++*k;
+                return (uint32_t)(i * L + j);
+            }
+        }
+        return BACKBONE_NONE;
+    }
+
+    i = v / L;
+    j = v % L;
+    while (bb->edge[v] < EDGE_DONE)
+    {
+        switch (bb->edge[v]++)
+        {
+            case EDGE_UP:
+                if (i > 0 && IN_CLUSTER(bb, i - 1, j))
+                {
+                    return v - L;
+                }
+            break;
+            case EDGE_DOWN:
+                if (i + 1 < L && IN_CLUSTER(bb, i + 1, j))
+                {
+                    return v + L;
+                }
+            break;
+            case EDGE_LEFT:
+                if (j > 0 && IN_CLUSTER(bb, i, j - 1))
+                {
+                    return v - 1;
+                }
+            break;
+            case EDGE_RIGHT:
+                if (j + 1 < L && IN_CLUSTER(bb, i, j + 1))
+                {
+                    return v + 1;
+                }
+            break;
+            case EDGE_SOURCE:
+                if (i == 0)
+                {
+                    return n;
+                }
+            break;
+            case EDGE_SINK:
+                if (i + 1 == L)
+                {
+                    return n + 1;
+                }
+            break;
+        }
+    }
+    return BACKBONE_NONE;
+}
+
+/*
+ * Iterative Tarjan search for biconnected blocks starting at the source.
+ * Sink is the first neighbour of the source and its only tree child, so
+ * the block closed last, when sink returns to source, is the one with the
+ * source-sink edge: sites carrying current between top and bottom.
+ */
+static size_t backbone_mass(backbone_t * bb)
+{
+    size_t n = bb->L * bb->L, depth = 1, top = 1, mass = 0;
+    size_t virtual_edge[2] = {0, 0};
+    uint32_t source = n, sink = n + 1, time = 0;
+
+    memset(bb->disc, 0, (n + 2) * sizeof(uint32_t));
+    bb->disc[source] = bb->low[source] = ++time;
+    bb->path[0] = source;
+    bb->block[0] = source;
+
+    while (depth > 0)
+    {
+        uint32_t v = bb->path[depth - 1];
+        uint32_t w = backbone_neighbour(bb, v, virtual_edge);
+
+        if (w == BACKBONE_NONE)
+        {
+            uint32_t u, x;
+
+            if (--depth == 0)
+            {
+                break;
+            }
+
+            u = bb->path[depth - 1];
+            if (bb->low[v] < bb->low[u])
+            {
+                bb->low[u] = bb->low[v];
+            }
+            if (bb->low[v] >= bb->disc[u])
+            {
+                do
+                {
+                    x = bb->block[--top];
+                    mass += (u == source && x != sink);
+                } while (x != v);
+            }
+            continue;
+        }
+
+        if (bb->disc[w] == 0)
+        {
+            bb->disc[w] = bb->low[w] = ++time;
+            if (w < n)
+            {
+                bb->edge[w] = EDGE_UP;
+            }
+            bb->path[depth++] = w;
+            bb->block[top++] = w;
+        }
+        else if ((depth < 2 || w != bb->path[depth - 2]) &&
+                 bb->disc[w] < bb->low[v])
+        {
+            bb->low[v] = bb->disc[w];
+        }
+    }
+
+    return mass;
+}
+
+/*
+ * Analyses cluster label of labelled lattice, which should touch both top
+ * and bottom rows. Fills chemical distance (steps from top to bottom row),
+ * cluster mass, backbone and dangling ends mass.
+ */
+int backbone_analyse(backbone_t * backbone, const lattice_t * lattice,
+                     uint32_t label)
+{
+    int retval = GSL_SUCCESS;
+    size_t i, j, L, words, top = 0, bottom = 0;
+
+    if (backbone == NULL || lattice == NULL || label == 0 ||
+        backbone->L != lattice->L)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    L = backbone->L;
+    words = backbone->row_words;
+    memset(backbone->cluster, 0, L * words * sizeof(uint64_t));
+    backbone->mass = 0;
+
+    for (i = 0; i < L; ++i)
+    {
+        const uint32_t * row = lattice->labels + i * L;
+        uint64_t * bits = backbone->cluster + i * words;
+
+        for (j = 0; j < L; ++j)
+        {
+            if (row[j] == label)
+            {
+                bits[j / LATTICE_WORD_BITS] |=
+                    (uint64_t)1 << (j % LATTICE_WORD_BITS);
+                ++backbone->mass;
+                top += (i == 0);
+                bottom += (i + 1 == L);
+            }
+        }
+    }
+
+    if (top == 0 || bottom == 0)
+    {
+        retval = GSL_EINVAL;
+        goto done;
+    }
+
+    backbone->chemical_distance = backbone_distance(backbone);
+    backbone->backbone = backbone_mass(backbone);
+    backbone->dangling = backbone->mass - backbone->backbone;
+done:
+    return retval;
+}
@@ -0,0 +1,43 @@
+#ifndef BACKBONE_H
+#define BACKBONE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lattice.h"
+
+/*
+ * Structure analysis of the spanning cluster.
+ *
+ * cluster, frontier, next and visited are bitsets with lattice row layout.
+ * Chemical distance is found by BFS that expands whole 64-site words of the
+ * frontier at once. Backbone is the biconnected block that holds virtual
+ * top and bottom terminals, found by iterative Tarjan search over disc and
+ * low arrays, everything else in the cluster is dangling ends.
+ */
+typedef struct backbone_s
+{
+    size_t     L;
+    size_t     row_words;
+    uint64_t * cluster;
+    uint64_t * frontier;
+    uint64_t * next;
+    uint64_t * visited;
+    uint32_t * disc;
+    uint32_t * low;
+    uint32_t * path;
+    uint32_t * block;
+    uint8_t  * edge;
+    size_t     chemical_distance;
+    size_t     mass;
+    size_t     backbone;
+    size_t     dangling;
+} backbone_t;
+
+backbone_t * backbone_alloc(size_t L);
+void backbone_free(backbone_t * backbone);
+
+int backbone_analyse(backbone_t * backbone, const lattice_t * lattice,
+                     uint32_t label);
+
+#endif
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <sys/resource.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "bench.h"
+#include "lattice.h"
+
+#define BENCH_MIN_SECONDS       (0.2)
+#define BENCH_KERNELS           (4)
+
+#define KERNEL_FILL             (0)
+#define KERNEL_LABEL            (1)
+#define KERNEL_MERGED           (2)
+#define KERNEL_CHECK            (3)
+
+static const double bench_densities[] = {0.55, 0.5927, 0.65};
+static const char * bench_names[BENCH_KERNELS] =
+{
+    "fill_grid", "hoshen_kopelman", "hosheen_kopelman_merged",
+    "check_percollation"
+};
+
+typedef struct bench_row_s
+{
+    const char * kernel;
+    size_t       L;
+    double       p;
+    size_t       repeats;
+    double       seconds;
+    double       mean_path;
+    uint32_t     max_path;
+    long         process_peak_rss;
+} bench_row_t;
+
+/*
+ * Peak resident set size of the whole process in kilobytes. It never
+ * decreases, so a row shows the largest footprint of all rows so far.
+ */
+static long bench_process_peak_rss(void)
+{
+    struct rusage usage;
+
+    if (0 != getrusage(RUSAGE_SELF, &usage))
+    {
+        return -1;
+    }
+    return usage.ru_maxrss;
+}
+
+static void bench_kernel(lattice_t * lattice, int kernel, double p,
+                         uint64_t seed)
+{
+    switch (kernel)
+    {
+        case KERNEL_FILL:
+            fill_grid(lattice, p, seed);
+        break;
+        case KERNEL_LABEL:
+            hoshen_kopelman(lattice);
+        break;
+        case KERNEL_MERGED:
+            hosheen_kopelman_merged(lattice, p, seed);
+        break;
+        default:
+            check_percollation(lattice);
+        break;
+    }
+}
+
+/*
+ * Labels filled lattice without flattening and measures depth of every
+ * label. parent[x] < x for non-roots, so depths come in one ascending pass.
+ */
+static int bench_path(lattice_t * lattice, double * mean, uint32_t * max)
+{
+    size_t i;
+    uint32_t k, used, * depth = NULL;
+    uint32_t * parent = lattice->parent;
+    double total = 0;
+
+    depth = malloc(lattice->parent_size * sizeof(uint32_t));
+    if (depth == NULL)
+    {
+        return GSL_ENOMEM;
+    }
+
+    parent[0] = 0;
+    for (i = 0; i < lattice->L; ++i)
+    {
+        hk_label_row(lattice, i, i != 0, parent);
+    }
+
+    used = parent[0];
+    *max = 0;
+    for (k = 1; k <= used; ++k)
+    {
+        depth[k] = (parent[k] == k ? 0 : depth[parent[k]] + 1);
+        total += depth[k];
+        *max = (depth[k] > *max ? depth[k] : *max);
+    }
+    *mean = (used != 0 ? total / used : 0);
+
+    free(depth);
+    return GSL_SUCCESS;
+}
+
+static void bench_write(FILE * out, int format, const bench_row_t * row,
+                        int first)
+{
+    double cells = (double)row->L * (double)row->L * (double)row->repeats;
+    double rate = (row->seconds > 0 ? cells / row->seconds : 0);
+
+    if (format == BENCH_JSON)
+    {
+        fprintf(out, "%s  {\"kernel\": \"%s\", \"L\": %lu, \"p\": %g, "
+                "\"repeats\": %lu, \"seconds\": %e, \"cells_per_second\": %e, "
+                "\"process_peak_rss_kb\": %ld, \"mean_path\": %f, "
+                "\"max_path\": %u}",
+                first ? "" : ",\n", row->kernel, (unsigned long)row->L,
+                row->p, (unsigned long)row->repeats, row->seconds, rate,
+                row->process_peak_rss, row->mean_path, row->max_path);
+        return;
+    }
+
+    fprintf(out, "%s,%lu,%g,%lu,%e,%e,%ld,%f,%u\n", row->kernel,
+            (unsigned long)row->L, row->p, (unsigned long)row->repeats,
+            row->seconds, rate, row->process_peak_rss, row->mean_path,
+            row->max_path);
+}
+
+int bench_run(const size_t * sizes, size_t count, uint64_t seed, int format,
+              FILE * out)
+{
+    int retval = GSL_SUCCESS, first = 1, kernel;
+    size_t s, d;
+    lattice_t * lattice = NULL;
+
+    if (sizes == NULL || out == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    if (format == BENCH_JSON)
+    {
+        fprintf(out, "[\n");
+    }
+    else
+    {
+        fprintf(out, "kernel,L,p,repeats,seconds,cells_per_second,"
+                "process_peak_rss_kb,mean_path,max_path\n");
+    }
+
+    for (s = 0; s < count; ++s)
+    {
+        lattice = lattice_alloc(sizes[s]);
+        if (lattice == NULL)
+        {
+            retval = GSL_ENOMEM;
+            goto done;
+        }
+
+        for (d = 0; d < sizeof(bench_densities) / sizeof(double); ++d)
+        {
+            double p = bench_densities[d], mean_path = 0;
+            uint32_t max_path = 0;
+
+            fill_grid(lattice, p, seed);
+            retval = bench_path(lattice, &mean_path, &max_path);
+            if (retval != GSL_SUCCESS)
+            {
+                goto done;
+            }
+
+            for (kernel = 0; kernel < BENCH_KERNELS; ++kernel)
+            {
+                bench_row_t row;
+                clock_t start;
+
+                /* Labelling kernels read the grid, check reads labels */
+                fill_grid(lattice, p, seed);
+                hoshen_kopelman(lattice);
+
+                row.kernel = bench_names[kernel];
+                row.L = sizes[s];
+                row.p = p;
+                row.repeats = 0;
+                start = clock();
+                do
+                {
+                    bench_kernel(lattice, kernel, p, seed);
+                    ++row.repeats;
+                    row.seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+                } while (row.seconds < BENCH_MIN_SECONDS);
+
+                row.process_peak_rss = bench_process_peak_rss();
+                row.mean_path = (kernel == KERNEL_LABEL ||
+                                 kernel == KERNEL_MERGED ? mean_path : 0);
+                row.max_path = (kernel == KERNEL_LABEL ||
+                                kernel == KERNEL_MERGED ? max_path : 0);
+                bench_write(out, format, &row, first);
+                first = 0;
+                fflush(out);
+            }
+        }
+
+        lattice_free(lattice);
+        lattice = NULL;
+    }
+
+    if (format == BENCH_JSON)
+    {
+        fprintf(out, "\n]\n");
+    }
+done:
+    lattice_free(lattice);
+    return retval;
+}
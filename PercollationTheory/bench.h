@@ -0,0 +1,25 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BENCH_CSV               (0)
+#define BENCH_JSON              (1)
+
+/*
+ * Times fill_grid, hoshen_kopelman, hosheen_kopelman_merged and
+ * check_percollation for every size and density near the threshold.
+ * Every kernel is repeated until it runs for at least BENCH_MIN_SECONDS of
+ * processor time. Throughput is given in grid cells per second for every
+ * kernel, so check_percollation shows how cheap it is next to labelling.
+ * Union-find path length is depth of labels in the forest left by the
+ * labelling pass before it is flattened. process_peak_rss_kb is the high
+ * water mark of the whole process, so it is cumulative over rows and grows
+ * only when a larger L needs more memory than any earlier case.
+ */
+int bench_run(const size_t * sizes, size_t count, uint64_t seed, int format,
+              FILE * out);
+
+#endif
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "cubic.h"
+#include "lattice.h"
+#include "rng.h"
+
+cubic_t * cubic_alloc(size_t L)
+{
+    cubic_t * cubic = NULL;
+    lattice_t * view;
+
+    /* Both planes may hold up to L * ceil(L / 2) labels each */
+    if (L == 0 || L > SIZE_MAX / L || L * ((L + 1) / 2) >= UINT32_MAX / 2)
+    {
+        fprintf(stderr, "Error: bad grid size %lu.\n", (unsigned long)L);
+        goto done;
+    }
+
+    cubic = calloc(1, sizeof(cubic_t));
+    if (cubic == NULL)
+    {
+        goto done;
+    }
+
+    view = &cubic->view;
+    view->L = L;
+    view->row_words = (L + LATTICE_WORD_BITS - 1) / LATTICE_WORD_BITS;
+    view->parent_size = 2 * L * ((L + 1) / 2) + 1;
+
+    view->occupied = calloc(view->row_words * L, sizeof(uint64_t));
+    view->labels = calloc(L * L, sizeof(uint32_t));
+    view->parent = calloc(view->parent_size, sizeof(uint32_t));
+    view->sizes = calloc(view->parent_size, sizeof(uint32_t));
+    cubic->previous = calloc(L * L, sizeof(uint32_t));
+    cubic->remap = calloc(view->parent_size, sizeof(uint32_t));
+    cubic->top = calloc(view->parent_size, sizeof(uint8_t));
+    cubic->next_top = calloc(view->parent_size, sizeof(uint8_t));
+
+    if (view->occupied == NULL || view->labels == NULL ||
+        view->parent == NULL || view->sizes == NULL ||
+        cubic->previous == NULL || cubic->remap == NULL ||
+        cubic->top == NULL || cubic->next_top == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate %lu^3 grid planes.\n",
+                (unsigned long)L);
+        cubic_free(cubic);
+        cubic = NULL;
+    }
+done:
+    return cubic;
+}
+
+void cubic_free(cubic_t * cubic)
+{
+    if (cubic == NULL)
+    {
+        return;
+    }
+
+    free(cubic->view.occupied);
+    free(cubic->view.labels);
+    free(cubic->view.parent);
+    free(cubic->view.sizes);
+    free(cubic->previous);
+    free(cubic->remap);
+    free(cubic->top);
+    free(cubic->next_top);
+    free(cubic);
+}
+
+/* Plane z is generated as rows z * L .. z * L + L - 1 of the 2D generator */
+static void cubic_fill_plane(lattice_t * view, uint64_t z, uint64_t seed,
+                             uint64_t threshold)
+{
+    size_t i, w, L = view->L, tail = L % LATTICE_WORD_BITS;
+
+    for (i = 0; i < L; ++i)
+    {
+        uint64_t * row = view->occupied + i * view->row_words;
+        for (w = 0; w < view->row_words; ++w)
+        {
+            row[w] = philox_occupancy(seed, z * L + i, w, threshold);
+        }
+        if (tail != 0)
+        {
+            row[view->row_words - 1] &= ((uint64_t)1 << tail) - 1;
+        }
+    }
+}
+
+/*
+ * Checks whether a cluster connects planes z = 0 and z = L - 1. Every plane
+ * is labelled by the 2D engine (up and left neighbours) and then linked to
+ * the previous plane, which covers the sixth neighbour. Afterwards labels
+ * are renumbered from 1 and moved to previous, so the working set is two
+ * planes plus union-find table of O(L^2). Stops early when no cluster
+ * connected to z = 0 survives. planes gets number of processed planes.
+ */
+int cubic_percollates(cubic_t * cubic, double fill_probability,
+                      uint64_t seed, int * percollates, size_t * planes)
+{
+    int retval = GSL_SUCCESS;
+    size_t z, j, L, n;
+    uint64_t threshold = philox_threshold(fill_probability);
+    uint32_t live = 0;
+    lattice_t * view;
+
+    if (cubic == NULL || percollates == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    view = &cubic->view;
+    L = view->L;
+    n = L * L;
+    *percollates = 0;
+
+    for (z = 0; z < L; ++z)
+    {
+        uint32_t * current = view->labels;
+        uint32_t * previous = cubic->previous;
+        uint32_t * parent = view->parent;
+        uint32_t k, used = live, alive = 0;
+        uint32_t last_current = 0, last_previous = 0;
+        size_t i;
+        uint8_t * swap;
+
+        for (k = 1; k <= live; ++k)
+        {
+            parent[k] = k;
+            view->sizes[k] = 0;
+        }
+
+        cubic_fill_plane(view, z, seed, threshold);
+        for (i = 0; i < L; ++i)
+        {
+            hk_label_row(view, i, i != 0, &used);
+        }
+
+        for (k = live + 1; k <= used; ++k)
+        {
+            cubic->top[k] = (z == 0);
+        }
+
+        /* Link to the previous plane, runs of equal pairs are skipped */
+        if (z != 0)
+        {
+            for (j = 0; j < n; ++j)
+            {
+                if (current[j] == 0 || previous[j] == 0)
+                {
+                    continue;
+                }
+                if (current[j] != last_current || previous[j] != last_previous)
+                {
+                    hk_union(parent, current[j], previous[j]);
+                    last_current = current[j];
+                    last_previous = previous[j];
+                }
+            }
+        }
+
+        for (k = 1; k <= used; ++k)
+        {
+            uint32_t root = hk_find(parent, k);
+            cubic->top[root] |= cubic->top[k];
+            cubic->remap[k] = 0;
+        }
+
+        live = 0;
+        for (j = 0; j < n; ++j)
+        {
+            uint32_t root;
+            if (current[j] == 0)
+            {
+                previous[j] = 0;
+                continue;
+            }
+
+            root = hk_find(parent, current[j]);
+            if (cubic->remap[root] == 0)
+            {
+                cubic->remap[root] = ++live;
+                cubic->next_top[live] = cubic->top[root];
+                alive |= cubic->top[root];
+            }
+            previous[j] = cubic->remap[root];
+        }
+
+        swap = cubic->top;
+        cubic->top = cubic->next_top;
+        cubic->next_top = swap;
+
+        if (!alive)
+        {
+            ++z;
+            break;
+        }
+        if (z == L - 1)
+        {
+            *percollates = 1;
+        }
+    }
+
+    if (planes != NULL)
+    {
+        *planes = z;
+    }
+done:
+    return retval;
+}
@@ -0,0 +1,30 @@
+#ifndef CUBIC_H
+#define CUBIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lattice.h"
+
+/*
+ * Site percollation on L x L x L cubic lattice checked plane by plane
+ * along z. view is a single L x L plane labelled with the 2D engine,
+ * previous holds previous plane relabelled to 1..live, so only two planes
+ * are kept in memory. top[k] tells whether label k reaches plane z = 0.
+ */
+typedef struct cubic_s
+{
+    lattice_t  view;
+    uint32_t * previous;
+    uint32_t * remap;
+    uint8_t  * top;
+    uint8_t  * next_top;
+} cubic_t;
+
+cubic_t * cubic_alloc(size_t L);
+void cubic_free(cubic_t * cubic);
+
+int cubic_percollates(cubic_t * cubic, double fill_probability,
+                      uint64_t seed, int * percollates, size_t * planes);
+
+#endif
@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "dynamic.h"
+#include "lattice.h"
+
+#define WORD_INDEX(j)           ((j) / LATTICE_WORD_BITS)
+#define BIT_INDEX(j)            ((j) % LATTICE_WORD_BITS)
+
+#define IS_SET(d, v)            \
+    (((d)->occupied[((v) / (d)->L) * (d)->row_words + \
+                    WORD_INDEX((v) % (d)->L)] >> BIT_INDEX((v) % (d)->L)) & 1)
+
+#define DYNAMIC_INITIAL_QUEUE   (1024)
+
+dynamic_t * dynamic_alloc(const lattice_t * lattice)
+{
+    dynamic_t * dynamic = NULL;
+    size_t k, s, L, n;
+    uint32_t id, max_id = 0;
+
+    if (lattice == NULL)
+    {
+        goto done;
+    }
+
+    L = lattice->L;
+    n = L * L;
+    if (n >= UINT32_MAX / 2)
+    {
+        fprintf(stderr, "Error: grid size %lu is too big for 32-bit ids.\n",
+                (unsigned long)L);
+        goto done;
+    }
+
+    dynamic = calloc(1, sizeof(dynamic_t));
+    if (dynamic == NULL)
+    {
+        goto done;
+    }
+
+    /*
+     * Square lattice has at most ceil(n / 2) clusters, so renumbering
+     * always leaves room for pieces of one more removal
+     */
+    dynamic->L = L;
+    dynamic->row_words = lattice->row_words;
+    dynamic->capacity = n + DYNAMIC_SEARCHES + 1;
+
+    dynamic->occupied = malloc(L * dynamic->row_words * sizeof(uint64_t));
+    dynamic->labels = malloc(n * sizeof(uint32_t));
+    dynamic->parent = malloc(dynamic->capacity * sizeof(uint32_t));
+    dynamic->size = calloc(dynamic->capacity, sizeof(uint32_t));
+    dynamic->top = calloc(dynamic->capacity, sizeof(uint32_t));
+    dynamic->bottom = calloc(dynamic->capacity, sizeof(uint32_t));
+    dynamic->remap = calloc(dynamic->capacity, sizeof(uint32_t));
+    dynamic->seen = calloc(n, sizeof(uint32_t));
+
+    for (s = 0; s < DYNAMIC_SEARCHES; ++s)
+    {
+        dynamic->queue_capacity[s] = (n < DYNAMIC_INITIAL_QUEUE ?
+                                      n : DYNAMIC_INITIAL_QUEUE);
+        dynamic->queue[s] = malloc(dynamic->queue_capacity[s] *
+                                   sizeof(uint32_t));
+    }
+
+    if (dynamic->occupied == NULL || dynamic->labels == NULL ||
+        dynamic->parent == NULL || dynamic->size == NULL ||
+        dynamic->top == NULL || dynamic->bottom == NULL ||
+        dynamic->remap == NULL || dynamic->seen == NULL ||
+        dynamic->queue[0] == NULL || dynamic->queue[1] == NULL ||
+        dynamic->queue[2] == NULL || dynamic->queue[3] == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate dynamic connectivity.\n");
+        dynamic_free(dynamic);
+        dynamic = NULL;
+        goto done;
+    }
+
+    memcpy(dynamic->occupied, lattice->occupied,
+           L * dynamic->row_words * sizeof(uint64_t));
+    memcpy(dynamic->labels, lattice->labels, n * sizeof(uint32_t));
+
+    for (id = 0; id < dynamic->capacity; ++id)
+    {
+        dynamic->parent[id] = id;
+    }
+
+    /* Labels of the lattice are cluster roots after any labelling pass */
+    for (k = 0; k < n; ++k)
+    {
+        id = dynamic->labels[k];
+        if (id == 0)
+        {
+            continue;
+        }
+        max_id = (id > max_id ? id : max_id);
+        dynamic->size[id]++;
+        dynamic->top[id] += (k < L);
+        dynamic->bottom[id] += (k >= n - L);
+    }
+
+    for (id = 1; id <= max_id; ++id)
+    {
+        dynamic->spanning += (dynamic->top[id] != 0 &&
+                              dynamic->bottom[id] != 0);
+    }
+    dynamic->next_id = max_id + 1;
+    dynamic->stamp = DYNAMIC_SEARCHES;
+done:
+    return dynamic;
+}
+
+void dynamic_free(dynamic_t * dynamic)
+{
+    size_t s;
+
+    if (dynamic == NULL)
+    {
+        return;
+    }
+
+    free(dynamic->occupied);
+    free(dynamic->labels);
+    free(dynamic->parent);
+    free(dynamic->size);
+    free(dynamic->top);
+    free(dynamic->bottom);
+    free(dynamic->remap);
+    free(dynamic->seen);
+    for (s = 0; s < DYNAMIC_SEARCHES; ++s)
+    {
+        free(dynamic->queue[s]);
+    }
+    free(dynamic);
+}
+
+static uint32_t dynamic_find(dynamic_t * dynamic, uint32_t x)
+{
+    uint32_t * parent = dynamic->parent;
+
+    while (parent[x] != x)
+    {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+static int dynamic_spans(const dynamic_t * dynamic, uint32_t root)
+{
+    return (dynamic->top[root] != 0 && dynamic->bottom[root] != 0);
+}
+
+/* Renumbers live clusters from 1 so that released ids can be reused */
+static void dynamic_compact(dynamic_t * dynamic)
+{
+    size_t k, n = dynamic->L * dynamic->L;
+    uint32_t id, live = 0;
+
+    for (id = 1; id < dynamic->next_id; ++id)
+    {
+        dynamic->remap[id] = 0;
+        if (dynamic->parent[id] == id && dynamic->size[id] != 0)
+        {
+            /* live <= id, so counters move down without overlap */
+            dynamic->remap[id] = ++live;
+            dynamic->size[live] = dynamic->size[id];
+            dynamic->top[live] = dynamic->top[id];
+            dynamic->bottom[live] = dynamic->bottom[id];
+        }
+    }
+
+    for (k = 0; k < n; ++k)
+    {
+        if (dynamic->labels[k] != 0)
+        {
+            dynamic->labels[k] =
+                dynamic->remap[dynamic_find(dynamic, dynamic->labels[k])];
+        }
+    }
+
+    for (id = 1; id < dynamic->next_id; ++id)
+    {
+        dynamic->parent[id] = id;
+        if (id > live)
+        {
+            dynamic->size[id] = dynamic->top[id] = dynamic->bottom[id] = 0;
+        }
+    }
+    dynamic->next_id = live + 1;
+}
+
+static uint32_t dynamic_new_id(dynamic_t * dynamic)
+{
+    uint32_t id = dynamic->next_id++;
+
+    dynamic->parent[id] = id;
+    dynamic->size[id] = dynamic->top[id] = dynamic->bottom[id] = 0;
+    return id;
+}
+
+/* Collects occupied neighbours of site v */
+static size_t dynamic_neighbours(const dynamic_t * dynamic, size_t v,
+                                 uint32_t out[DYNAMIC_SEARCHES])
+{
+    size_t L = dynamic->L, i = v / L, j = v % L, count = 0;
+
+    if (i > 0 && IS_SET(dynamic, v - L))
+    {
+        out[count++] = v - L;
+    }
+    if (j > 0 && IS_SET(dynamic, v - 1))
+    {
+        out[count++] = v - 1;
+    }
+    if (j + 1 < L && IS_SET(dynamic, v + 1))
+    {
+        out[count++] = v + 1;
+    }
+    if (i + 1 < L && IS_SET(dynamic, v + L))
+    {
+        out[count++] = v + L;
+    }
+    return count;
+}
+
+int dynamic_is_occupied(const dynamic_t * dynamic, size_t i, size_t j)
+{
+    return (int)IS_SET(dynamic, i * dynamic->L + j);
+}
+
+/* Occupies site (i, j) and unites clusters around it, smaller into bigger */
+int dynamic_add(dynamic_t * dynamic, size_t i, size_t j)
+{
+    int retval = GSL_SUCCESS;
+    size_t v, k, count, L;
+    uint32_t neighbours[DYNAMIC_SEARCHES];
+    uint32_t root = 0, other, swap;
+
+    if (dynamic == NULL || i >= dynamic->L || j >= dynamic->L)
+    {
+        retval = GSL_EINVAL;
+        goto done;
+    }
+
+    L = dynamic->L;
+    v = i * L + j;
+    if (IS_SET(dynamic, v))
+    {
+        goto done;
+    }
+
+    if (dynamic->next_id >= dynamic->capacity)
+    {
+        dynamic_compact(dynamic);
+    }
+
+    count = dynamic_neighbours(dynamic, v, neighbours);
+    for (k = 0; k < count; ++k)
+    {
+        other = dynamic_find(dynamic, dynamic->labels[neighbours[k]]);
+        if (other == root)
+        {
+            continue;
+        }
+
+        dynamic->spanning -= dynamic_spans(dynamic, other);
+        if (root == 0)
+        {
+            root = other;
+            continue;
+        }
+
+        if (dynamic->size[other] > dynamic->size[root])
+        {
+            swap = root;
+            root = other;
+            other = swap;
+        }
+        dynamic->parent[other] = root;
+        dynamic->size[root] += dynamic->size[other];
+        dynamic->top[root] += dynamic->top[other];
+        dynamic->bottom[root] += dynamic->bottom[other];
+    }
+
+    if (root == 0)
+    {
+        root = dynamic_new_id(dynamic);
+    }
+
+    dynamic->occupied[i * dynamic->row_words + WORD_INDEX(j)] |=
+        (uint64_t)1 << BIT_INDEX(j);
+    dynamic->labels[v] = root;
+    dynamic->size[root]++;
+    dynamic->top[root] += (i == 0);
+    dynamic->bottom[root] += (i + 1 == L);
+    dynamic->spanning += dynamic_spans(dynamic, root);
+done:
+    return retval;
+}
+
+static int dynamic_push(dynamic_t * dynamic, size_t s, size_t * tail,
+                        uint32_t v)
+{
+    if (*tail == dynamic->queue_capacity[s])
+    {
+        size_t capacity = 2 * dynamic->queue_capacity[s];
+        uint32_t * queue = realloc(dynamic->queue[s],
+                                   capacity * sizeof(uint32_t));
+        if (queue == NULL)
+        {
+            return GSL_ENOMEM;
+        }
+        dynamic->queue[s] = queue;
+        dynamic->queue_capacity[s] = capacity;
+    }
+
+    dynamic->queue[s][(*tail)++] = v;
+    dynamic->seen[v] = dynamic->stamp + (uint32_t)s;
+    return GSL_SUCCESS;
+}
+
+static size_t group_find(size_t * group, size_t s)
+{
+    while (group[s] != s)
+    {
+        s = group[s];
+    }
+    return s;
+}
+
+/*
+ * Empties site (i, j). Searches from its neighbours run in lockstep and
+ * join when they meet, so the loop ends as soon as at most one group of
+ * searches can still grow. Every finished group other than the kept one
+ * is a separate piece and moves to a new id.
+ */
+int dynamic_remove(dynamic_t * dynamic, size_t i, size_t j)
+{
+    int retval = GSL_SUCCESS;
+    size_t v, k, s, t, count, L, running, keep;
+    size_t head[DYNAMIC_SEARCHES], tail[DYNAMIC_SEARCHES];
+    size_t group[DYNAMIC_SEARCHES], visited[DYNAMIC_SEARCHES];
+    uint32_t neighbours[DYNAMIC_SEARCHES], around[DYNAMIC_SEARCHES];
+    uint32_t root;
+
+    if (dynamic == NULL || i >= dynamic->L || j >= dynamic->L)
+    {
+        retval = GSL_EINVAL;
+        goto done;
+    }
+
+    L = dynamic->L;
+    v = i * L + j;
+    if (!IS_SET(dynamic, v))
+    {
+        goto done;
+    }
+
+    if (dynamic->next_id + DYNAMIC_SEARCHES >= dynamic->capacity)
+    {
+        dynamic_compact(dynamic);
+    }
+
+    root = dynamic_find(dynamic, dynamic->labels[v]);
+    dynamic->spanning -= dynamic_spans(dynamic, root);
+
+    dynamic->occupied[i * dynamic->row_words + WORD_INDEX(j)] &=
+        ~((uint64_t)1 << BIT_INDEX(j));
+    dynamic->labels[v] = 0;
+    dynamic->size[root]--;
+    dynamic->top[root] -= (i == 0);
+    dynamic->bottom[root] -= (i + 1 == L);
+
+    /* Dead end or isolated site can not split the cluster */
+    count = dynamic_neighbours(dynamic, v, neighbours);
+    if (count < 2)
+    {
+        dynamic->spanning += dynamic_spans(dynamic, root);
+        goto done;
+    }
+
+    if (dynamic->stamp > UINT32_MAX - 2 * DYNAMIC_SEARCHES)
+    {
+        memset(dynamic->seen, 0, L * L * sizeof(uint32_t));
+        dynamic->stamp = 0;
+    }
+    dynamic->stamp += DYNAMIC_SEARCHES;
+
+    for (s = 0; s < count; ++s)
+    {
+        head[s] = tail[s] = 0;
+        group[s] = s;
+        retval = dynamic_push(dynamic, s, &tail[s], neighbours[s]);
+        if (retval != GSL_SUCCESS)
+        {
+            goto done;
+        }
+    }
+
+    for (running = count; running > 1;)
+    {
+        for (s = 0; s < count; ++s)
+        {
+            size_t g, around_count;
+            uint32_t u;
+
+            if (head[s] == tail[s])
+            {
+                continue;
+            }
+
+            u = dynamic->queue[s][head[s]++];
+            g = group_find(group, s);
+            around_count = dynamic_neighbours(dynamic, u, around);
+            for (k = 0; k < around_count; ++k)
+            {
+                uint32_t w = around[k];
+                if (dynamic->seen[w] >= dynamic->stamp &&
+                    dynamic->seen[w] < dynamic->stamp + DYNAMIC_SEARCHES)
+                {
+                    size_t h = group_find(group, dynamic->seen[w] -
+                                                 dynamic->stamp);
+                    if (h != g)
+                    {
+                        group[h] = g;
+                    }
+                    continue;
+                }
+
+                retval = dynamic_push(dynamic, s, &tail[s], w);
+                if (retval != GSL_SUCCESS)
+                {
+                    goto done;
+                }
+            }
+        }
+
+        /* Groups that may still grow */
+        running = 0;
+        for (s = 0; s < count; ++s)
+        {
+            visited[s] = 0;
+        }
+        for (s = 0; s < count; ++s)
+        {
+            visited[group_find(group, s)] |= (head[s] != tail[s]);
+        }
+        for (s = 0; s < count; ++s)
+        {
+            running += (group_find(group, s) == s && visited[s]);
+        }
+    }
+
+    /* Keep the growing group, or the biggest one when all have finished */
+    for (s = 0; s < count; ++s)
+    {
+        visited[s] = 0;
+    }
+    for (s = 0; s < count; ++s)
+    {
+        visited[group_find(group, s)] += tail[s] +
+                                         (head[s] != tail[s] ? L * L : 0);
+    }
+    keep = group_find(group, 0);
+    for (s = 0; s < count; ++s)
+    {
+        if (group_find(group, s) == s && visited[s] > visited[keep])
+        {
+            keep = s;
+        }
+    }
+
+    for (s = 0; s < count; ++s)
+    {
+        uint32_t piece;
+
+        if (group_find(group, s) != s || s == keep)
+        {
+            continue;
+        }
+
+        piece = dynamic_new_id(dynamic);
+        for (t = 0; t < count; ++t)
+        {
+            if (group_find(group, t) != s)
+            {
+                continue;
+            }
+            for (k = 0; k < tail[t]; ++k)
+            {
+                uint32_t w = dynamic->queue[t][k];
+                dynamic->labels[w] = piece;
+                dynamic->size[piece]++;
+                dynamic->top[piece] += (w < L);
+                dynamic->bottom[piece] += (w >= L * L - L);
+            }
+        }
+
+        dynamic->size[root] -= dynamic->size[piece];
+        dynamic->top[root] -= dynamic->top[piece];
+        dynamic->bottom[root] -= dynamic->bottom[piece];
+        dynamic->spanning += dynamic_spans(dynamic, piece);
+    }
+    dynamic->spanning += dynamic_spans(dynamic, root);
+done:
+    return retval;
+}
+
+int dynamic_flip(dynamic_t * dynamic, size_t i, size_t j)
+{
+    if (dynamic == NULL || i >= dynamic->L || j >= dynamic->L)
+    {
+        return GSL_EINVAL;
+    }
+
+    return (dynamic_is_occupied(dynamic, i, j) ?
+            dynamic_remove(dynamic, i, j) : dynamic_add(dynamic, i, j));
+}
@@ -0,0 +1,52 @@
+#ifndef DYNAMIC_H
+#define DYNAMIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lattice.h"
+
+#define DYNAMIC_SEARCHES        (4)
+
+/*
+ * Connectivity of a labelled lattice kept up to date under single-site
+ * flips. labels maps sites to cluster ids, ids are joined in union-find
+ * parent table, roots hold cluster size and number of sites in top and
+ * bottom rows, spanning counts clusters touching both.
+ *
+ * Adding a site unites neighbouring clusters. Removing one starts a BFS
+ * from every occupied neighbour, one site of each search per round, until
+ * at most one search still runs: finished searches are pieces that broke
+ * off and get new ids, so work is proportional to the smaller pieces.
+ * seen stamps sites with stamp + search number, queue[s] keeps sites of
+ * search s. Unused ids are reclaimed by renumbering when capacity runs out.
+ */
+typedef struct dynamic_s
+{
+    size_t     L;
+    size_t     capacity;
+    uint32_t   next_id;
+    uint64_t * occupied;
+    size_t     row_words;
+    uint32_t * labels;
+    uint32_t * parent;
+    uint32_t * size;
+    uint32_t * top;
+    uint32_t * bottom;
+    uint32_t * remap;
+    uint32_t * seen;
+    uint32_t   stamp;
+    uint32_t * queue[DYNAMIC_SEARCHES];
+    size_t     queue_capacity[DYNAMIC_SEARCHES];
+    size_t     spanning;
+} dynamic_t;
+
+dynamic_t * dynamic_alloc(const lattice_t * lattice);
+void dynamic_free(dynamic_t * dynamic);
+
+int dynamic_add(dynamic_t * dynamic, size_t i, size_t j);
+int dynamic_remove(dynamic_t * dynamic, size_t i, size_t j);
+int dynamic_flip(dynamic_t * dynamic, size_t i, size_t j);
+int dynamic_is_occupied(const dynamic_t * dynamic, size_t i, size_t j);
+
+#endif
@@ -0,0 +1,237 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "ensemble.h"
+#include "newman_ziff.h"
+#include "rng.h"
+
+/* 95% confidence interval */
+#define ENSEMBLE_Z              (1.96)
+/* Variance estimate is too noisy to stop earlier than that */
+#define ENSEMBLE_MIN_RUNS       (30)
+
+/*
+ * State shared by all worker threads, guarded by lock. Finished results
+ * wait in results until every realization with a smaller index is done,
+ * prefix of them is already added to the ensemble.
+ */
+typedef struct ensemble_pool_s
+{
+    ensemble_t *    ensemble;
+    pthread_mutex_t lock;
+    size_t          next;
+    size_t          total;
+    size_t          prefix;
+    size_t *        results;
+    unsigned char * finished;
+    unsigned int    seed;
+    double          target_width;
+    double          m2;
+    int             stop;
+    int             error;
+} ensemble_pool_t;
+
+ensemble_t * ensemble_alloc(size_t L)
+{
+    ensemble_t * ensemble = calloc(1, sizeof(ensemble_t));
+    if (ensemble == NULL)
+    {
+        goto done;
+    }
+
+    ensemble->L = L;
+    ensemble->spanning = calloc(L * L + 1, sizeof(uint32_t));
+    if (ensemble->spanning == NULL)
+    {
+        free(ensemble);
+        ensemble = NULL;
+    }
+done:
+    return ensemble;
+}
+
+void ensemble_free(ensemble_t * ensemble)
+{
+    if (ensemble == NULL)
+    {
+        return;
+    }
+
+    free(ensemble->spanning);
+    free(ensemble);
+}
+
+/* Full width of confidence interval of the mean threshold */
+double ensemble_interval(const ensemble_t * ensemble)
+{
+    if (ensemble->realizations < 2)
+    {
+        return HUGE_VAL;
+    }
+    return 2 * ENSEMBLE_Z *
+           sqrt(ensemble->variance / (double)ensemble->realizations);
+}
+
+/* Welford update of mean and variance, called with lock held */
+static void ensemble_add(ensemble_pool_t * pool, size_t spanning_at)
+{
+    ensemble_t * ensemble = pool->ensemble;
+    size_t N = ensemble->L * ensemble->L;
+    double threshold = (double)spanning_at / (double)N;
+    double delta = threshold - ensemble->mean;
+
+    ensemble->spanning[spanning_at]++;
+    ensemble->realizations++;
+    ensemble->mean += delta / (double)ensemble->realizations;
+    pool->m2 += delta * (threshold - ensemble->mean);
+    if (ensemble->realizations > 1)
+    {
+        ensemble->variance = pool->m2 / (double)(ensemble->realizations - 1);
+    }
+
+    if (pool->target_width > 0 &&
+        ensemble->realizations >= ENSEMBLE_MIN_RUNS &&
+        ensemble_interval(ensemble) <= pool->target_width)
+    {
+        pool->stop = 1;
+    }
+}
+
+/*
+ * Stores result of realization index and adds the finished prefix in index
+ * order, called with lock held. Mean, variance and early stop point are
+ * then the same for any number of threads, results past the stop point
+ * are dropped.
+ */
+static void ensemble_finish(ensemble_pool_t * pool, size_t index,
+                            size_t spanning_at)
+{
+    pool->results[index] = spanning_at;
+    pool->finished[index] = 1;
+    while (!pool->stop && pool->prefix < pool->total &&
+           pool->finished[pool->prefix])
+    {
+        ensemble_add(pool, pool->results[pool->prefix++]);
+    }
+}
+
+/*
+ * Every worker owns its own Newman-Ziff workspace. Realization k always
+ * uses random stream k, so results do not depend on which thread ran it.
+ */
+static void * ensemble_worker(void * arg)
+{
+    ensemble_pool_t * pool = arg;
+    newman_ziff_t * nz = newman_ziff_alloc(pool->ensemble->L);
+    rng_t rng;
+
+    if (nz == NULL)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->error = GSL_ENOMEM;
+        pool->stop = 1;
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+
+    for (;;)
+    {
+        size_t index, spanning_at = 0;
+
+        pthread_mutex_lock(&pool->lock);
+        if (pool->stop || pool->next >= pool->total)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        index = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        rng_seed(&rng, pool->seed, index);
+        newman_ziff_run(nz, &rng, NULL, &spanning_at);
+
+        pthread_mutex_lock(&pool->lock);
+        ensemble_finish(pool, index, spanning_at);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    newman_ziff_free(nz);
+    return NULL;
+}
+
+/*
+ * Runs up to given number of realizations on a pool of threads. When
+ * target_width is positive, stops at the first realization index where
+ * confidence interval of the mean threshold gets narrower than that.
+ */
+int ensemble_run(ensemble_t * ensemble, size_t realizations, size_t threads,
+                 unsigned int seed, double target_width)
+{
+    int retval = GSL_SUCCESS;
+    size_t t, started, N;
+    pthread_t * workers = NULL;
+    ensemble_pool_t pool;
+
+    memset(&pool, 0, sizeof(pool));
+    if (ensemble == NULL || threads == 0)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    N = ensemble->L * ensemble->L;
+    memset(ensemble->spanning, 0, (N + 1) * sizeof(uint32_t));
+    ensemble->realizations = 0;
+    ensemble->mean = 0;
+    ensemble->variance = 0;
+
+    pool.ensemble = ensemble;
+    pool.total = realizations;
+    pool.seed = seed;
+    pool.target_width = target_width;
+
+    workers = malloc(threads * sizeof(pthread_t));
+    pool.results = malloc(realizations * sizeof(size_t));
+    pool.finished = calloc(realizations, sizeof(unsigned char));
+    if (workers == NULL || (realizations > 0 &&
+        (pool.results == NULL || pool.finished == NULL)))
+    {
+        retval = GSL_ENOMEM;
+        goto done;
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    for (started = 0; started < threads; ++started)
+    {
+        if (0 != pthread_create(&workers[started], NULL, ensemble_worker,
+                                &pool))
+        {
+            fprintf(stderr, "Error: could not start ensemble thread.\n");
+            break;
+        }
+    }
+    for (t = 0; t < started; ++t)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    pthread_mutex_destroy(&pool.lock);
+
+    retval = (started == 0 ? GSL_FAILURE : pool.error);
+
+    /* Turn per-step counts into cumulative ones */
+    for (t = 1; t <= N; ++t)
+    {
+        ensemble->spanning[t] += ensemble->spanning[t - 1];
+    }
+done:
+    free(workers);
+    free(pool.results);
+    free(pool.finished);
+    return retval;
+}
@@ -0,0 +1,29 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Statistics of an ensemble of independent Newman-Ziff realizations on the
+ * same L x L grid. spanning[n] is number of realizations that percollated
+ * with n or fewer occupied sites, so spanning[n] / realizations is
+ * percollation probability at p = n / L^2.
+ */
+typedef struct ensemble_s
+{
+    size_t     L;
+    size_t     realizations;
+    double     mean;
+    double     variance;
+    uint32_t * spanning;
+} ensemble_t;
+
+ensemble_t * ensemble_alloc(size_t L);
+void ensemble_free(ensemble_t * ensemble);
+
+int ensemble_run(ensemble_t * ensemble, size_t realizations, size_t threads,
+                 unsigned int seed, double target_width);
+double ensemble_interval(const ensemble_t * ensemble);
+
+#endif
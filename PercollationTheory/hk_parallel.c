@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "lattice.h"
+#include "rng.h"
+
+/*
+ * Horizontal strip of the lattice labelled by one thread. Labels of strip
+ * are taken from the range (first_label, first_label + ceil(L / 2) * rows],
+ * so ranges of different strips never intersect. When fill is set, strip
+ * rows are generated right before they are labelled. stats collects
+ * clusters whose roots lie in the strip label range.
+ */
+typedef struct hk_strip_s
+{
+    lattice_t * lattice;
+    size_t      first_row;
+    size_t      last_row;
+    uint32_t    first_label;
+    uint32_t    last_label;
+    int         fill;
+    uint64_t    seed;
+    uint64_t    threshold;
+    cluster_stats_t stats;
+} hk_strip_t;
+
+/* Same as hk_find, but never writes to the table */
+static uint32_t hk_root(const uint32_t * parent, uint32_t x)
+{
+    while (parent[x] != x)
+    {
+        x = parent[x];
+    }
+    return x;
+}
+
+static void * hk_strip_label(void * arg)
+{
+    hk_strip_t * strip = arg;
+    uint32_t * parent = strip->lattice->parent;
+    uint32_t * sizes = strip->lattice->sizes;
+    size_t i;
+    uint32_t k;
+
+    strip->last_label = strip->first_label;
+    for (i = strip->first_row; i < strip->last_row; ++i)
+    {
+        if (strip->fill)
+        {
+            fill_grid_row(strip->lattice, i, strip->seed, strip->threshold);
+        }
+        hk_label_row(strip->lattice, i, i != strip->first_row,
+                     &strip->last_label);
+    }
+
+    /*
+     * No links leave the strip yet, so its part of the table is flattened
+     * the same way as in serial version
+     */
+    for (k = strip->first_label + 1; k <= strip->last_label; ++k)
+    {
+        parent[k] = parent[parent[k]];
+        if (parent[k] != k)
+        {
+            sizes[parent[k]] += sizes[k];
+        }
+    }
+    return NULL;
+}
+
+static void * hk_strip_relabel(void * arg)
+{
+    hk_strip_t * strip = arg;
+    const uint32_t * parent = strip->lattice->parent;
+    size_t L = strip->lattice->L;
+    const uint32_t * sizes = strip->lattice->sizes;
+    uint32_t * labels = strip->lattice->labels + strip->first_row * L;
+    uint32_t * end = strip->lattice->labels + strip->last_row * L;
+    uint32_t k;
+
+    for (; labels != end; ++labels)
+    {
+        *labels = hk_root(parent, *labels);
+    }
+
+    cluster_stats_reset(&strip->stats);
+    for (k = strip->first_label + 1; k <= strip->last_label; ++k)
+    {
+        if (parent[k] == k)
+        {
+            cluster_stats_add(&strip->stats, k, sizes[k]);
+        }
+    }
+    return NULL;
+}
+
+static int hk_run_strips(hk_strip_t * strips, pthread_t * workers,
+                         size_t threads, void * (*routine)(void *))
+{
+    int retval = GSL_SUCCESS;
+    size_t t, started;
+
+    for (started = 0; started < threads; ++started)
+    {
+        if (0 != pthread_create(&workers[started], NULL, routine,
+                                &strips[started]))
+        {
+            fprintf(stderr, "Error: could not start labelling thread.\n");
+            retval = GSL_FAILURE;
+            break;
+        }
+    }
+
+    for (t = 0; t < started; ++t)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    return retval;
+}
+
+static int hk_parallel(lattice_t * lattice, size_t threads, int fill,
+                       uint64_t seed, double fill_probability)
+{
+    int retval = GSL_SUCCESS;
+    size_t t, j, L, rows_per_strip, labels_per_row;
+    hk_strip_t * strips = NULL;
+    pthread_t * workers = NULL;
+    uint32_t * parent, * sizes;
+
+    if (lattice == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    L = lattice->L;
+    if (threads > L)
+    {
+        threads = L;
+    }
+    if (threads <= 1 && fill)
+    {
+        retval = hosheen_kopelman_merged(lattice, fill_probability, seed);
+        goto done;
+    }
+    if (threads <= 1)
+    {
+        retval = hoshen_kopelman(lattice);
+        goto done;
+    }
+
+    strips = malloc(threads * sizeof(hk_strip_t));
+    workers = malloc(threads * sizeof(pthread_t));
+    if (strips == NULL || workers == NULL)
+    {
+        retval = GSL_ENOMEM;
+        goto done;
+    }
+
+    parent = lattice->parent;
+    sizes = lattice->sizes;
+    rows_per_strip = (L + threads - 1) / threads;
+    labels_per_row = (L + 1) / 2;
+    threads = (L + rows_per_strip - 1) / rows_per_strip;
+
+    for (t = 0; t < threads; ++t)
+    {
+        strips[t].lattice = lattice;
+        strips[t].first_row = t * rows_per_strip;
+        strips[t].last_row = strips[t].first_row + rows_per_strip;
+        if (strips[t].last_row > L)
+        {
+            strips[t].last_row = L;
+        }
+        strips[t].first_label = strips[t].first_row * labels_per_row;
+        strips[t].fill = fill;
+        strips[t].seed = seed;
+        strips[t].threshold = philox_threshold(fill_probability);
+    }
+
+    retval = hk_run_strips(strips, workers, threads, hk_strip_label);
+    if (retval != GSL_SUCCESS)
+    {
+        goto done;
+    }
+
+    /* Stitch strips together along their boundaries */
+    parent[0] = 0;
+    for (t = 1; t < threads; ++t)
+    {
+        const uint32_t * below = lattice->labels + strips[t].first_row * L;
+        const uint32_t * above = below - L;
+        for (j = 0; j < L; ++j)
+        {
+            uint32_t x, y, root;
+            if (above[j] == 0 || below[j] == 0)
+            {
+                continue;
+            }
+
+            x = hk_find(parent, above[j]);
+            y = hk_find(parent, below[j]);
+            if (x != y)
+            {
+                root = hk_union(parent, x, y);
+                sizes[root] += sizes[root == x ? y : x];
+            }
+        }
+    }
+
+    retval = hk_run_strips(strips, workers, threads, hk_strip_relabel);
+    if (retval != GSL_SUCCESS)
+    {
+        goto done;
+    }
+
+    cluster_stats_reset(&lattice->stats);
+    for (t = 0; t < threads; ++t)
+    {
+        cluster_stats_merge(&lattice->stats, &strips[t].stats);
+    }
+    cluster_stats_finish(&lattice->stats);
+
+    /*
+     * Labels are not contiguous here, so parent[0] is just an upper bound.
+     * Unused labels between strip ranges keep values of previous runs and
+     * point to 0, so passes over 1..parent[0] never take them for roots.
+     */
+    for (t = 0; t + 1 < threads; ++t)
+    {
+        uint32_t k;
+        for (k = strips[t].last_label + 1; k <= strips[t + 1].first_label;
+             ++k)
+        {
+            parent[k] = 0;
+        }
+    }
+    parent[0] = strips[threads - 1].last_label;
+done:
+    free(strips);
+    free(workers);
+    return retval;
+}
+
+int hoshen_kopelman_parallel(lattice_t * lattice, size_t threads)
+{
+    return hk_parallel(lattice, threads, 0, 0, 0);
+}
+
+int hosheen_kopelman_merged_parallel(lattice_t * lattice,
+                                     double fill_probability, uint64_t seed,
+                                     size_t threads)
+{
+    return hk_parallel(lattice, threads, 1, seed, fill_probability);
+}
@@ -0,0 +1,414 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "lattice.h"
+#include "rng.h"
+
+#define WORD_INDEX(j)           ((j) / LATTICE_WORD_BITS)
+#define BIT_INDEX(j)            ((j) % LATTICE_WORD_BITS)
+#define IS_OCCUPIED(row, j)     (((row)[WORD_INDEX(j)] >> BIT_INDEX(j)) & 1)
+
+lattice_t * lattice_alloc(size_t L)
+{
+    lattice_t * lattice = NULL;
+
+    if (L == 0)
+    {
+        fprintf(stderr, "Error: grid size should be positive.\n");
+        goto done;
+    }
+
+    /*
+     * New label is created only when left neighbour is empty, so there are
+     * at most ceil(L / 2) new labels in a row. Cluster sizes are 32-bit too
+     * and a single cluster may hold all L * L sites.
+     */
+    if (L > SIZE_MAX / L || L * L >= UINT32_MAX)
+    {
+        fprintf(stderr, "Error: grid size %lu is too big for 32-bit labels "
+                "and cluster sizes.\n", (unsigned long)L);
+        goto done;
+    }
+
+    lattice = calloc(1, sizeof(lattice_t));
+    if (lattice == NULL)
+    {
+        goto done;
+    }
+
+    lattice->L = L;
+    lattice->row_words = (L + LATTICE_WORD_BITS - 1) / LATTICE_WORD_BITS;
+    lattice->parent_size = L * ((L + 1) / 2) + 1;
+
+    lattice->occupied = calloc(lattice->row_words * L, sizeof(uint64_t));
+    lattice->labels = calloc(L * L, sizeof(uint32_t));
+    lattice->parent = calloc(lattice->parent_size, sizeof(uint32_t));
+    lattice->sizes = calloc(lattice->parent_size, sizeof(uint32_t));
+    lattice->marks = calloc((lattice->parent_size + LATTICE_WORD_BITS - 1) /
+                            LATTICE_WORD_BITS, sizeof(uint64_t));
+
+    if (lattice->occupied == NULL || lattice->labels == NULL ||
+        lattice->parent == NULL || lattice->sizes == NULL ||
+        lattice->marks == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate %lux%lu grid.\n",
+                (unsigned long)L, (unsigned long)L);
+        lattice_free(lattice);
+        lattice = NULL;
+    }
+done:
+    return lattice;
+}
+
+void lattice_free(lattice_t * lattice)
+{
+    if (lattice == NULL)
+    {
+        return;
+    }
+
+    free(lattice->occupied);
+    free(lattice->labels);
+    free(lattice->parent);
+    free(lattice->sizes);
+    free(lattice->marks);
+    free(lattice);
+}
+
+uint32_t hk_find(uint32_t * parent, uint32_t x)
+{
+    /* Path halving: every visited node is linked to its grandparent */
+    while (parent[x] != x)
+    {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+uint32_t hk_union(uint32_t * parent, uint32_t x, uint32_t y)
+{
+    x = hk_find(parent, x);
+    y = hk_find(parent, y);
+
+    /* Smaller label always becomes the root, so parent[x] <= x holds */
+    if (x < y)
+    {
+        parent[y] = x;
+        return x;
+    }
+    parent[x] = y;
+    return y;
+}
+
+void cluster_stats_reset(cluster_stats_t * stats)
+{
+    memset(stats, 0, sizeof(cluster_stats_t));
+}
+
+void cluster_stats_add(cluster_stats_t * stats, uint32_t label, uint32_t size)
+{
+    size_t bin = 0;
+
+    while ((size >> bin) > 1)
+    {
+        ++bin;
+    }
+
+    stats->clusters++;
+    stats->occupied += size;
+    stats->squares += (double)size * (double)size;
+    stats->histogram[bin]++;
+    if (size > stats->largest)
+    {
+        stats->largest = size;
+        stats->largest_label = label;
+    }
+}
+
+void cluster_stats_merge(cluster_stats_t * stats,
+                         const cluster_stats_t * other)
+{
+    size_t b;
+
+    stats->clusters += other->clusters;
+    stats->occupied += other->occupied;
+    stats->squares += other->squares;
+    for (b = 0; b < LATTICE_HISTOGRAM_BINS; ++b)
+    {
+        stats->histogram[b] += other->histogram[b];
+    }
+    if (other->largest > stats->largest)
+    {
+        stats->largest = other->largest;
+        stats->largest_label = other->largest_label;
+    }
+}
+
+void cluster_stats_finish(cluster_stats_t * stats)
+{
+    stats->mean = (stats->clusters == 0 ? 0 :
+                   (double)stats->occupied / (double)stats->clusters);
+    stats->weighted_mean = (stats->occupied == 0 ? 0 :
+                            stats->squares / (double)stats->occupied);
+}
+
+/*
+ * Labels row i of the lattice. When link_above is set the row is connected
+ * to already labelled row i - 1, otherwise it is treated as the top row.
+ * New labels are taken from *counter, every site is counted in sizes of its
+ * provisional label.
+ */
+void hk_label_row(lattice_t * lattice, size_t i, int link_above,
+                  uint32_t * counter)
+{
+    size_t j, L = lattice->L;
+    const uint64_t * row = lattice->occupied + i * lattice->row_words;
+    uint32_t * current = lattice->labels + i * L;
+    const uint32_t * above = (link_above ? current - L : NULL);
+    uint32_t * parent = lattice->parent;
+    uint32_t * sizes = lattice->sizes;
+    uint32_t left = 0;
+
+    for (j = 0; j < L; ++j)
+    {
+        uint32_t up, label;
+
+        if (BIT_INDEX(j) == 0 && row[WORD_INDEX(j)] == 0)
+        {
+            size_t count = (L - j < LATTICE_WORD_BITS ? L - j : LATTICE_WORD_BITS);
+            memset(current + j, 0, count * sizeof(uint32_t));
+            j += count - 1;
+            left = 0;
+            continue;
+        }
+
+        if (!IS_OCCUPIED(row, j))
+        {
+            current[j] = left = 0;
+            continue;
+        }
+
+        up = (above == NULL ? 0 : above[j]);
+
+        switch (!!up + !!left)
+        {
+            case 0:
+                label = ++(*counter);
+                parent[label] = label;
+                sizes[label] = 0;
+            break;
+            case 1:
+                label = (up > left ? up : left);
+            break;
+            default:
+                label = (up == left ? up : hk_union(parent, up, left));
+            break;
+        }
+        current[j] = left = label;
+        sizes[label]++;
+    }
+}
+
+/*
+ * Replaces every provisional label with its root. Since parent[x] <= x, one
+ * ascending pass makes the table flat and relabelling becomes a plain gather.
+ * Same pass moves site counts to roots and collects cluster statistics.
+ */
+static void hk_relabel(lattice_t * lattice)
+{
+    size_t k, n = lattice->L * lattice->L;
+    uint32_t * parent = lattice->parent;
+    uint32_t * sizes = lattice->sizes;
+    uint32_t * labels = lattice->labels;
+    uint32_t used = parent[0];
+
+    parent[0] = 0;
+    for (k = 1; k <= used; ++k)
+    {
+        parent[k] = parent[parent[k]];
+        if (parent[k] != k)
+        {
+            sizes[parent[k]] += sizes[k];
+        }
+    }
+
+    cluster_stats_reset(&lattice->stats);
+    for (k = 1; k <= used; ++k)
+    {
+        if (parent[k] == k)
+        {
+            cluster_stats_add(&lattice->stats, k, sizes[k]);
+        }
+    }
+    cluster_stats_finish(&lattice->stats);
+
+    for (k = 0; k < n; ++k)
+    {
+        labels[k] = parent[labels[k]];
+    }
+    parent[0] = used;
+}
+
+/*
+ * Fills row i from counter-based generator keyed by seed. Every word of the
+ * row is generated independently, so row contents do not depend on who
+ * fills it or in which order.
+ */
+void fill_grid_row(lattice_t * lattice, size_t i, uint64_t seed,
+                   uint64_t threshold)
+{
+    size_t w, L = lattice->L;
+    uint64_t * row = lattice->occupied + i * lattice->row_words;
+
+    for (w = 0; w < lattice->row_words; ++w)
+    {
+        row[w] = philox_occupancy(seed, i, w, threshold);
+    }
+
+    /* Padding bits past the last site are always empty */
+    if (BIT_INDEX(L) != 0)
+    {
+        row[lattice->row_words - 1] &= ((uint64_t)1 << BIT_INDEX(L)) - 1;
+    }
+}
+
+int fill_grid(lattice_t * lattice, double fill_probability, uint64_t seed)
+{
+    int retval = GSL_SUCCESS;
+    size_t i;
+    uint64_t threshold = philox_threshold(fill_probability);
+
+    if (lattice == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    for (i = 0; i < lattice->L; ++i)
+    {
+        fill_grid_row(lattice, i, seed, threshold);
+    }
+
+done:
+    return retval;
+}
+
+int hoshen_kopelman(lattice_t * lattice)
+{
+    int retval = GSL_SUCCESS;
+    size_t i;
+
+    if (lattice == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    lattice->parent[0] = 0;
+    for (i = 0; i < lattice->L; ++i)
+    {
+        hk_label_row(lattice, i, i != 0, lattice->parent);
+    }
+    hk_relabel(lattice);
+done:
+    return retval;
+}
+
+int save_matrix(lattice_t * lattice)
+{
+    int retval = GSL_SUCCESS;
+    size_t i, j, L;
+    if (lattice == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    L = lattice->L;
+
+    for (i = 0; i < L; ++i)
+    {
+        for (j = 0; j < L; ++j)
+        {
+            printf("%2d ", (int)lattice->labels[i * L + j]);
+        }
+        printf("\n");
+    }
+done:
+    return retval;
+}
+
+int hosheen_kopelman_merged(lattice_t * lattice, double fill_probability,
+                            uint64_t seed)
+{
+    int retval = GSL_SUCCESS;
+    size_t i;
+    uint64_t threshold = philox_threshold(fill_probability);
+
+    if (lattice == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    lattice->parent[0] = 0;
+    for (i = 0; i < lattice->L; ++i)
+    {
+        fill_grid_row(lattice, i, seed, threshold);
+
+        /* Row is labelled while it is still hot in cache */
+        hk_label_row(lattice, i, i != 0, lattice->parent);
+    }
+    hk_relabel(lattice);
+done:
+    return retval;
+}
+
+/*
+ * Returns label of a cluster that connects top and bottom rows or -1. Top
+ * row labels are marked in a bitset, so each bottom site costs one lookup.
+ */
+int check_percollation(lattice_t * lattice)
+{
+    int retval = -1;
+    size_t i, L;
+    const uint32_t * top, * bottom;
+    uint64_t * marks;
+
+    if (lattice == NULL)
+    {
+        goto done;
+    }
+
+    L = lattice->L;
+    top = lattice->labels;
+    bottom = lattice->labels + (L - 1) * L;
+    marks = lattice->marks;
+
+    for (i = 0; i < L; ++i)
+    {
+        marks[WORD_INDEX(top[i])] |= (uint64_t)1 << BIT_INDEX(top[i]);
+    }
+
+    for (i = 0; i < L; ++i)
+    {
+        uint32_t label = bottom[i];
+        if (label != 0 && ((marks[WORD_INDEX(label)] >> BIT_INDEX(label)) & 1))
+        {
+            retval = label;
+            break;
+        }
+    }
+
+    /* Clear only words that were touched */
+    for (i = 0; i < L; ++i)
+    {
+        marks[WORD_INDEX(top[i])] = 0;
+    }
+done:
+    return retval;
+}
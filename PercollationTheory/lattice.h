@@ -0,0 +1,79 @@
+#ifndef LATTICE_H
+#define LATTICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LATTICE_WORD_BITS       (64)
+#define LATTICE_HISTOGRAM_BINS  (33)
+
+/*
+ * Cluster statistics gathered by labelling pass. histogram[b] is number of
+ * clusters with size in [2^b, 2^(b + 1)), weighted_mean is
+ * sum(s^2) / sum(s) over all clusters.
+ */
+typedef struct cluster_stats_s
+{
+    size_t   clusters;
+    size_t   occupied;
+    uint32_t largest;
+    uint32_t largest_label;
+    double   squares;
+    double   mean;
+    double   weighted_mean;
+    size_t   histogram[LATTICE_HISTOGRAM_BINS];
+} cluster_stats_t;
+
+/*
+ * Square lattice used by the percollation engine.
+ *
+ * Occupancy is bit-packed (one bit per site, each row padded to a whole
+ * number of 64-bit words), cluster labels are 32-bit integers with 0 meaning
+ * empty site. Union-find table is a contiguous array of parent indices where
+ * parent[x] <= x always holds, so a single ascending pass flattens it.
+ * sizes[x] counts sites labelled x and ends up summed in the root. marks is
+ * a scratch bitset with one bit per label.
+ */
+typedef struct lattice_s
+{
+    size_t     L;
+    size_t     row_words;
+    uint64_t * occupied;
+    uint32_t * labels;
+    uint32_t * parent;
+    uint32_t * sizes;
+    uint64_t * marks;
+    size_t     parent_size;
+    cluster_stats_t stats;
+} lattice_t;
+
+lattice_t * lattice_alloc(size_t L);
+void lattice_free(lattice_t * lattice);
+
+uint32_t hk_find(uint32_t * parent, uint32_t x);
+uint32_t hk_union(uint32_t * parent, uint32_t x, uint32_t y);
+
+void cluster_stats_reset(cluster_stats_t * stats);
+void cluster_stats_add(cluster_stats_t * stats, uint32_t label, uint32_t size);
+void cluster_stats_merge(cluster_stats_t * stats,
+                         const cluster_stats_t * other);
+void cluster_stats_finish(cluster_stats_t * stats);
+
+void hk_label_row(lattice_t * lattice, size_t i, int link_above,
+                  uint32_t * counter);
+
+void fill_grid_row(lattice_t * lattice, size_t i, uint64_t seed,
+                   uint64_t threshold);
+
+int fill_grid(lattice_t * lattice, double fill_probability, uint64_t seed);
+int hoshen_kopelman(lattice_t * lattice);
+int hosheen_kopelman_merged(lattice_t * lattice, double fill_probability,
+                            uint64_t seed);
+int hoshen_kopelman_parallel(lattice_t * lattice, size_t threads);
+int hosheen_kopelman_merged_parallel(lattice_t * lattice,
+                                     double fill_probability, uint64_t seed,
+                                     size_t threads);
+int check_percollation(lattice_t * lattice);
+int save_matrix(lattice_t * lattice);
+
+#endif
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "lattice.h"
+#include "lattice_io.h"
+
+#define RLE_MAGIC               "PRLE"
+#define RLE_MAGIC_SIZE          (4)
+#define RLE_VERSION             (1)
+#define RLE_BUFFER_SIZE         (1 << 20)
+/* LEB128 of 64-bit value takes at most 10 bytes */
+#define VARINT_MAX_SIZE         (10)
+
+typedef struct rle_writer_s
+{
+    FILE *          file;
+    unsigned char * buffer;
+    size_t          used;
+    int             error;
+} rle_writer_t;
+
+static void rle_flush(rle_writer_t * writer)
+{
+    if (writer->used != 0 &&
+        writer->used != fwrite(writer->buffer, 1, writer->used, writer->file))
+    {
+        writer->error = 1;
+    }
+    writer->used = 0;
+}
+
+static void rle_put_varint(rle_writer_t * writer, uint64_t value)
+{
+    if (writer->used + VARINT_MAX_SIZE > RLE_BUFFER_SIZE)
+    {
+        rle_flush(writer);
+    }
+
+    while (value >= 0x80)
+    {
+        writer->buffer[writer->used++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    writer->buffer[writer->used++] = (unsigned char)value;
+}
+
+static int rle_get_varint(FILE * file, uint64_t * value)
+{
+    int c, shift = 0;
+
+    *value = 0;
+    do
+    {
+        c = getc(file);
+        /* Tenth byte holds only the top bit of a 64-bit value */
+        if (c == EOF || shift > 63 || (shift == 63 && (c & 0x7E) != 0))
+        {
+            return GSL_FAILURE;
+        }
+        *value |= (uint64_t)(c & 0x7F) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    return GSL_SUCCESS;
+}
+
+/*
+ * Writes labels in compact binary form: "PRLE" magic, version byte, varint
+ * grid size and then every row as (run length, label) varint pairs. Runs
+ * never cross row boundary.
+ */
+int save_matrix_rle(lattice_t * lattice, FILE * file)
+{
+    int retval = GSL_SUCCESS;
+    size_t i, j, L;
+    rle_writer_t writer;
+
+    memset(&writer, 0, sizeof(writer));
+
+    if (lattice == NULL || file == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    writer.file = file;
+    writer.buffer = malloc(RLE_BUFFER_SIZE);
+    if (writer.buffer == NULL)
+    {
+        retval = GSL_ENOMEM;
+        goto done;
+    }
+
+    L = lattice->L;
+    memcpy(writer.buffer, RLE_MAGIC, RLE_MAGIC_SIZE);
+    writer.buffer[RLE_MAGIC_SIZE] = RLE_VERSION;
+    writer.used = RLE_MAGIC_SIZE + 1;
+    rle_put_varint(&writer, L);
+
+    for (i = 0; i < L; ++i)
+    {
+        const uint32_t * row = lattice->labels + i * L;
+        for (j = 0; j < L;)
+        {
+            size_t start = j;
+            uint32_t label = row[j];
+            while (j < L && row[j] == label)
+            {
+                ++j;
+            }
+            rle_put_varint(&writer, j - start);
+            rle_put_varint(&writer, label);
+        }
+    }
+
+    rle_flush(&writer);
+    if (writer.error || fflush(file) != 0)
+    {
+        fprintf(stderr, "Error: could not write grid.\n");
+        retval = GSL_EFAILED;
+    }
+done:
+    free(writer.buffer);
+    return retval;
+}
+
+/*
+ * Converts file written by save_matrix_rle to the text matrix save_matrix
+ * produces, one row at a time.
+ */
+int decode_matrix_rle(FILE * in, FILE * out)
+{
+    int retval = GSL_SUCCESS;
+    char magic[RLE_MAGIC_SIZE];
+    uint64_t L, i, j, length, label;
+    int version;
+
+    if (in == NULL || out == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    if (RLE_MAGIC_SIZE != fread(magic, 1, RLE_MAGIC_SIZE, in) ||
+        0 != memcmp(magic, RLE_MAGIC, RLE_MAGIC_SIZE))
+    {
+        fprintf(stderr, "Error: not a run-length encoded grid.\n");
+        retval = GSL_EINVAL;
+        goto done;
+    }
+
+    version = getc(in);
+    if (version != RLE_VERSION || GSL_SUCCESS != rle_get_varint(in, &L))
+    {
+        fprintf(stderr, "Error: unsupported grid file version.\n");
+        retval = GSL_EINVAL;
+        goto done;
+    }
+
+    for (i = 0; i < L; ++i)
+    {
+        for (j = 0; j < L; j += length)
+        {
+            uint64_t k;
+            if (GSL_SUCCESS != rle_get_varint(in, &length) ||
+                GSL_SUCCESS != rle_get_varint(in, &label) ||
+                length == 0 || length > L - j)
+            {
+                fprintf(stderr, "Error: corrupted grid file.\n");
+                retval = GSL_EFAILED;
+                goto done;
+            }
+            for (k = 0; k < length; ++k)
+            {
+                fprintf(out, "%2d ", (int)label);
+            }
+        }
+        fprintf(out, "\n");
+    }
+done:
+    return retval;
+}
@@ -0,0 +1,11 @@
+#ifndef LATTICE_IO_H
+#define LATTICE_IO_H
+
+#include <stdio.h>
+
+#include "lattice.h"
+
+int save_matrix_rle(lattice_t * lattice, FILE * file);
+int decode_matrix_rle(FILE * in, FILE * out);
+
+#endif
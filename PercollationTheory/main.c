@@ -11,24 +11,95 @@
 #include <unistd.h>
 
 #include <gsl/gsl_errno.h>
-#include <gsl/gsl_matrix.h>
-#include <gsl/gsl_vector.h>
+
+#include "lattice.h"
+#include "newman_ziff.h"
+#include "ensemble.h"
+#include "stream.h"
+#include "lattice_io.h"
+#include "cubic.h"
+#include "scaling.h"
+#include "torus.h"
+#include "backbone.h"
+#include "dynamic.h"
+#include "bench.h"
+#include "rng.h"
 
 #define UNUSED(x) (void)(x)
 
 #define DEFAULT_STEP            (1e-5)
 #define MAX_STRING_SIZE         (4096)
-#define OPTIONS                 "f:hp:s:vL:"
+#define MAX_SIZES               (64)
+#define OPTIONS                 "ab:d:e:f:hi:l:m:n:o:p:s:t:vw:FL:"
 
 #define OPTION_DEFAULT_FILE     "data.dat"
 
+#define OPTION_DEFAULT_FILL_PROBABILTY          (0.5)
+#define OPTION_DEFAULT_GRID_SIZE                (100lu)
+#define OPTION_DEFAULT_THREADS                  (1lu)
+#define OPTION_DEFAULT_MODE                     "linear"
+#define OPTION_DEFAULT_REALIZATIONS             (1000lu)
+#define OPTION_DEFAULT_WIDTH                    (0.0)
+#define OPTION_DEFAULT_DIMENSION                (2)
+
+#define MODE_LINEAR             (0)
+#define MODE_BISECT             (1)
+#define MODE_NEWMAN_ZIFF        (2)
+#define MODE_ENSEMBLE           (3)
+#define MODE_STREAM             (4)
+#define MODE_DECODE             (5)
+#define MODE_SCALING            (6)
+#define MODE_FLIP               (7)
+#define MODE_BENCH              (8)
+
+#define BOUNDARY_OPEN           (0)
+#define BOUNDARY_HORIZONTAL     (TORUS_WRAP_HORIZONTAL)
+#define BOUNDARY_VERTICAL       (TORUS_WRAP_VERTICAL)
+#define BOUNDARY_BOTH           (TORUS_WRAP_BOTH)
+#define BOUNDARY_EITHER         (4)
+
+#define FORMAT_TEXT             (0)
+#define FORMAT_RLE              (1)
+#define FORMAT_CSV              (2)
+#define FORMAT_JSON             (3)
+
+/* Returns positive value when grid with fill probability p percollates */
+typedef int (*probe_cb)(double p, void * params);
+
+typedef struct probe_params_s
+{
+    lattice_t *  lattice;
+    cubic_t *    cubic;
+    torus_t *    torus;
+    int          boundary;
+    unsigned int seed;
+    size_t       threads;
+} probe_params_t;
+
 void print_usage();
 
-int fill_grid(gsl_matrix * matrix, double fill_probability);
-int hoshen_kopelman(gsl_matrix * matrix);
-int save_matrix(gsl_matrix * matrix);
-int check_percollation(gsl_matrix * matrix);
-int hosheen_kopelman_merged(gsl_matrix * matrix, double fill_probability);
+int probe_grid(double p, void * params);
+int probe_cubic(double p, void * params);
+int check_wrapping(const torus_t * torus, int boundary);
+double find_limit_linear(probe_cb probe, void * params, double p,
+                         double step, int * label);
+double find_limit_bisect(probe_cb probe, void * params, double p,
+                         double eps, int * label);
+int search_cubic(size_t L, double p, double step, unsigned int seed,
+                 int mode);
+int parse_sizes(const char * list, size_t * sizes, size_t * count);
+int sweep_scaling(const size_t * sizes, size_t count, unsigned int seed,
+                  size_t realizations, size_t threads);
+int sweep_newman_ziff(size_t L, unsigned int seed);
+int sweep_ensemble(size_t L, unsigned int seed, size_t realizations,
+                   size_t threads, double width);
+int check_stream(size_t L, double p, unsigned int seed);
+int analyse_cluster(lattice_t * lattice, int label);
+int run_flips(lattice_t * lattice, double p, unsigned int seed,
+              size_t flips, size_t threads);
+void print_cluster_stats(const cluster_stats_t * stats, int verbose);
+int store_matrix(lattice_t * lattice, int format);
+int decode_file(const char * input_name);
 
 int main(int argc, char *const * argv)
 {
@@ -37,12 +108,80 @@ int main(int argc, char *const * argv)
     char option = 0;
     int verbose = 0;
     int force_save = 0;
+    int analyse = 0;
+    int mode = MODE_LINEAR;
+    int format = FORMAT_TEXT;
+    int boundary = BOUNDARY_OPEN;
     char file_name[MAX_STRING_SIZE] = OPTION_DEFAULT_FILE;
+    char input_name[MAX_STRING_SIZE] = "";
+
+    double p = OPTION_DEFAULT_FILL_PROBABILTY;
+    double step = DEFAULT_STEP;
+    unsigned int seed = (unsigned int)time(NULL);
+    size_t L = OPTION_DEFAULT_GRID_SIZE;
+    size_t threads = OPTION_DEFAULT_THREADS;
+    size_t realizations = OPTION_DEFAULT_REALIZATIONS;
+    double width = OPTION_DEFAULT_WIDTH;
+    int dimension = OPTION_DEFAULT_DIMENSION;
+    size_t sizes[MAX_SIZES];
+    size_t sizes_count = 0;
+    probe_params_t params;
+
+    lattice_t * lattice = NULL;
+    torus_t * torus = NULL;
 
     while ((option = getopt(argc, argv, OPTIONS)) != -1)
     {
         switch (option)
         {
+            case 'a':
+                analyse = 1;
+            break;
+            case 'b':
+                if (0 == strcmp(optarg, "open"))
+                {
+                    boundary = BOUNDARY_OPEN;
+                }
+                else if (0 == strcmp(optarg, "horizontal"))
+                {
+                    boundary = BOUNDARY_HORIZONTAL;
+                }
+                else if (0 == strcmp(optarg, "vertical"))
+                {
+                    boundary = BOUNDARY_VERTICAL;
+                }
+                else if (0 == strcmp(optarg, "both"))
+                {
+                    boundary = BOUNDARY_BOTH;
+                }
+                else if (0 == strcmp(optarg, "either"))
+                {
+                    boundary = BOUNDARY_EITHER;
+                }
+                else
+                {
+                    fprintf(stderr, "Error: unknown boundary conditions %s.\n", optarg);
+                    retval = GSL_EINVAL;
+                    goto done;
+                }
+            break;
+            case 'd':
+                if (1 != sscanf(optarg, "%d", &dimension) ||
+                    (dimension != 2 && dimension != 3))
+                {
+                    fprintf(stderr, "Error: bad dimension. Should be 2 or 3.\n");
+                    retval = GSL_ERANGE;
+                    goto done;
+                }
+            break;
+            case 'e':
+                if (1 != sscanf(optarg, "%le", &step) || step <= 0)
+                {
+                    fprintf(stderr, "Error: bad step value. Should be positive number.\n");
+                    retval = GSL_ERANGE;
+                    goto done;
+                }
+            break;
             case 'f':
                 strcpy(file_name, optarg);
             break;
@@ -51,6 +190,93 @@ int main(int argc, char *const * argv)
                 retval = GSL_SUCCESS;
                 goto done;
             break;
+            case 'i':
+                strcpy(input_name, optarg);
+            break;
+            case 'l':
+                if (GSL_SUCCESS != parse_sizes(optarg, sizes, &sizes_count))
+                {
+                    fprintf(stderr, "Error: bad list of grid sizes. Should be up to %d comma separated numbers.\n", MAX_SIZES);
+                    retval = GSL_ERANGE;
+                    goto done;
+                }
+            break;
+            case 'm':
+                if (0 == strcmp(optarg, "linear"))
+                {
+                    mode = MODE_LINEAR;
+                }
+                else if (0 == strcmp(optarg, "bisect"))
+                {
+                    mode = MODE_BISECT;
+                }
+                else if (0 == strcmp(optarg, "nz"))
+                {
+                    mode = MODE_NEWMAN_ZIFF;
+                }
+                else if (0 == strcmp(optarg, "ensemble"))
+                {
+                    mode = MODE_ENSEMBLE;
+                }
+                else if (0 == strcmp(optarg, "stream"))
+                {
+                    mode = MODE_STREAM;
+                }
+                else if (0 == strcmp(optarg, "decode"))
+                {
+                    mode = MODE_DECODE;
+                }
+                else if (0 == strcmp(optarg, "scaling"))
+                {
+                    mode = MODE_SCALING;
+                }
+                else if (0 == strcmp(optarg, "flip"))
+                {
+                    mode = MODE_FLIP;
+                }
+                else if (0 == strcmp(optarg, "bench"))
+                {
+                    mode = MODE_BENCH;
+                }
+                else
+                {
+                    fprintf(stderr, "Error: unknown mode %s.\n", optarg);
+                    retval = GSL_EINVAL;
+                    goto done;
+                }
+            break;
+            case 'n':
+                if (1 != sscanf(optarg, "%lu", &realizations) || realizations == 0)
+                {
+                    fprintf(stderr, "Error: bad number of realizations. Should be positive number.\n");
+                    retval = GSL_ERANGE;
+                    goto done;
+                }
+            break;
+            case 'o':
+                if (0 == strcmp(optarg, "text"))
+                {
+                    format = FORMAT_TEXT;
+                }
+                else if (0 == strcmp(optarg, "rle"))
+                {
+                    format = FORMAT_RLE;
+                }
+                else if (0 == strcmp(optarg, "csv"))
+                {
+                    format = FORMAT_CSV;
+                }
+                else if (0 == strcmp(optarg, "json"))
+                {
+                    format = FORMAT_JSON;
+                }
+                else
+                {
+                    fprintf(stderr, "Error: unknown output format %s.\n", optarg);
+                    retval = GSL_EINVAL;
+                    goto done;
+                }
+            break;
             case 'p':
                 if (1 != sscanf(optarg, "%le", &p))
                 {
@@ -73,9 +299,25 @@ int main(int argc, char *const * argv)
                     goto done;
                 }
             break;
+            case 't':
+                if (1 != sscanf(optarg, "%lu", &threads) || threads == 0)
+                {
+                    fprintf(stderr, "Error: bad number of threads. Should be positive number.\n");
+                    retval = GSL_ERANGE;
+                    goto done;
+                }
+            break;
             case 'v':
                 verbose = 1;
             break;
+            case 'w':
+                if (1 != sscanf(optarg, "%le", &width) || width < 0)
+                {
+                    fprintf(stderr, "Error: bad confidence interval width. Should be non-negative number.\n");
+                    retval = GSL_ERANGE;
+                    goto done;
+                }
+            break;
             case 'F':
                 force_save = 1;
             break;
@@ -99,6 +341,7 @@ int main(int argc, char *const * argv)
         printf("# Fill probability:                       %f\n", p);
         printf("# Grid size:                              %lu\n", L);
         printf("# Random seed:                            %u\n", seed);
+        printf("# Threads:                                %lu\n", threads);
     }
 
     if (stdout != freopen(file_name, "w", stdout))
@@ -108,351 +351,625 @@ int main(int argc, char *const * argv)
         goto done;
     }
 
-    matrix = gsl_matrix_alloc(L, L);
-    if (force_save)
+    if (mode == MODE_DECODE)
     {
-        srand(seed);
-        gsl_matrix_set_all(matrix, 0);
-        fill_grid(matrix, p);
-        hoshen_kopelman(matrix);
-        save_matrix(matrix);
+        retval = decode_file(input_name);
+        goto done;
+    }
 
+    if (dimension == 3)
+    {
+        retval = search_cubic(L, p, step, seed, mode);
         goto done;
     }
 
-    for (; p <= 1; p += step)
+    if (mode == MODE_NEWMAN_ZIFF)
+    {
+        retval = sweep_newman_ziff(L, seed);
+        goto done;
+    }
+
+    if (mode == MODE_ENSEMBLE)
+    {
+        retval = sweep_ensemble(L, seed, realizations, threads, width);
+        goto done;
+    }
+
+    if (mode == MODE_STREAM)
     {
-        srand(seed);
-        hosheen_kopelman_merged(matrix, p);
-        percollation_cluster_label = check_percollation(matrix);
+        retval = check_stream(L, p, seed);
+        goto done;
+    }
 
-        if (percollation_cluster_label > 0)
+    if (mode == MODE_SCALING)
+    {
+        if (realizations < 2)
         {
-            break;
+            fprintf(stderr, "Error: scaling needs at least 2 realizations per size to estimate variance.\n");
+            retval = GSL_ERANGE;
+            goto done;
+        }
+        if (sizes_count == 0)
+        {
+            sizes[sizes_count++] = L;
+        }
+        retval = sweep_scaling(sizes, sizes_count, seed, realizations,
+                               threads);
+        goto done;
+    }
+
+    if (mode == MODE_BENCH)
+    {
+        if (sizes_count == 0)
+        {
+            sizes[sizes_count++] = L;
+        }
+        retval = bench_run(sizes, sizes_count, seed,
+                           format == FORMAT_JSON ? BENCH_JSON : BENCH_CSV,
+                           stdout);
+        goto done;
+    }
+
+    lattice = lattice_alloc(L);
+    if (lattice == NULL)
+    {
+        retval = GSL_ENOMEM;
+        goto done;
+    }
+
+    if (mode == MODE_FLIP)
+    {
+        retval = run_flips(lattice, p, seed, realizations, threads);
+        goto done;
+    }
+
+    if (boundary != BOUNDARY_OPEN)
+    {
+        torus = torus_alloc(lattice);
+        if (torus == NULL)
+        {
+            retval = GSL_ENOMEM;
+            goto done;
         }
     }
 
-    save_matrix(matrix);
+    if (force_save)
+    {
+        hosheen_kopelman_merged_parallel(lattice, p, seed, threads);
+        if (torus != NULL)
+        {
+            hoshen_kopelman_torus(lattice, torus);
+            fprintf(stderr, "Wrapping cluster number: %d\n",
+                    check_wrapping(torus, boundary));
+        }
+        else if (analyse)
+        {
+            analyse_cluster(lattice, check_percollation(lattice));
+        }
+        store_matrix(lattice, format);
+        print_cluster_stats(&lattice->stats, verbose);
+
+        goto done;
+    }
+
+    memset(&params, 0, sizeof(params));
+    params.lattice = lattice;
+    params.torus = torus;
+    params.boundary = boundary;
+    params.seed = seed;
+    params.threads = threads;
+
+    switch (mode)
+    {
+        case MODE_BISECT:
+            p = find_limit_bisect(probe_grid, &params, p, step,
+                                  &percollation_cluster_label);
+        break;
+        default:
+            p = find_limit_linear(probe_grid, &params, p, step,
+                                  &percollation_cluster_label);
+        break;
+    }
+
+    store_matrix(lattice, format);
     fprintf(stderr, "Percollation cluster number: %d\n",
             percollation_cluster_label);
     fprintf(stderr, "Percollation limit: %1.5f\n", p);
+    print_cluster_stats(&lattice->stats, verbose);
+    if (analyse && torus == NULL)
+    {
+        analyse_cluster(lattice, percollation_cluster_label);
+    }
 
 done:
-    gsl_matrix_free(matrix);
+    torus_free(torus);
+    lattice_free(lattice);
     return retval;
 }
 
-int check_percollation(gsl_matrix * matrix)
+/*
+ * Fills grid with given seed, labels it and checks if it percollates.
+ * Returns percollation cluster label or -1.
+ */
+int probe_grid(double p, void * params)
 {
-    int retval = -1;
-    int * labels = NULL;
-    size_t i, k, j, L;
+    probe_params_t * probe = params;
 
-    if (matrix == NULL)
+    hosheen_kopelman_merged_parallel(probe->lattice, p, probe->seed,
+                                     probe->threads);
+    if (probe->torus != NULL)
     {
-        goto done;
+        hoshen_kopelman_torus(probe->lattice, probe->torus);
+        return check_wrapping(probe->torus, probe->boundary);
     }
+    return check_percollation(probe->lattice);
+}
+
+/* Returns label of cluster wrapping torus as boundary requires or -1 */
+int check_wrapping(const torus_t * torus, int boundary)
+{
+    int wraps = (boundary == BOUNDARY_EITHER ?
+                 torus->wrapping != 0 :
+                 (torus->wrapping & boundary) == boundary);
+
+    return (wraps ? (int)torus->wrapping_label : -1);
+}
+
+/* Same for cubic lattice, returns 1 or -1 since there are no labels kept */
+int probe_cubic(double p, void * params)
+{
+    probe_params_t * probe = params;
+    int percollates = 0;
 
-    L = matrix->size1;
-    labels = malloc(sizeof(int) * L);
+    cubic_percollates(probe->cubic, p, probe->seed, &percollates, NULL);
+    return (percollates ? 1 : -1);
+}
 
-    for (i = 0, j = 0; i < L; ++i)
+double find_limit_linear(probe_cb probe, void * params, double p,
+                         double step, int * label)
+{
+    for (; p <= 1; p += step)
     {
-        int label = gsl_matrix_get(matrix, 0, i);
-        if (label != 0)
+        *label = probe(p, params);
+
+        if (*label > 0)
         {
-            if (j != 0)
-            {
-                if (labels[j - 1] == label)
-                {
-                    continue;
-                }
-            }
-            labels[j++] = label;
+            break;
+        }
+    }
+    return p;
+}
+
+/*
+ * With fixed seed every site gets the same random number for every p, so
+ * grid only gains sites as p grows and percollation is monotonic in p. That
+ * allows to bisect [p, 1] instead of sweeping it, which takes
+ * log2((1 - p) / eps) labellings instead of (1 - p) / step.
+ */
+double find_limit_bisect(probe_cb probe, void * params, double p,
+                         double eps, int * label)
+{
+    double lo = p, hi = 1;
+
+    *label = probe(lo, params);
+    if (*label > 0)
+    {
+        return lo;
+    }
+
+    *label = probe(hi, params);
+    if (*label <= 0)
+    {
+        return hi;
+    }
+
+    while (hi - lo > eps)
+    {
+        double mid = 0.5 * (lo + hi);
+        if (probe(mid, params) > 0)
+        {
+            hi = mid;
         }
         else
         {
-            i += 1;
+            lo = mid;
         }
     }
 
-    for (i = 0; i < L; ++i)
+    /* Leave the grid in percollating state for save_matrix */
+    *label = probe(hi, params);
+    return hi;
+}
+
+/*
+ * Percollation along z on L x L x L cubic lattice: stream mode checks given
+ * p, linear and bisect modes search for the limit.
+ */
+int search_cubic(size_t L, double p, double step, unsigned int seed,
+                 int mode)
+{
+    int retval = GSL_SUCCESS;
+    int label = -1;
+    probe_params_t params;
+
+    memset(&params, 0, sizeof(params));
+    params.seed = seed;
+
+    if (mode != MODE_LINEAR && mode != MODE_BISECT && mode != MODE_STREAM)
     {
-        int label = gsl_matrix_get(matrix, L - 1, i);
-        for (k = 0; k < j; ++k)
-        {
-            if (labels[k] == label)
-            {
-                retval = label;
-                goto done;
-            }
-        }
+        fprintf(stderr, "Error: mode is not supported for cubic lattice.\n");
+        retval = GSL_EINVAL;
+        goto done;
+    }
+
+    params.cubic = cubic_alloc(L);
+    if (params.cubic == NULL)
+    {
+        retval = GSL_ENOMEM;
+        goto done;
+    }
+
+    switch (mode)
+    {
+        case MODE_STREAM:
+            label = probe_cubic(p, &params);
+            fprintf(stderr, "Percollates: %s\n", label > 0 ? "yes" : "no");
+        break;
+        case MODE_BISECT:
+            p = find_limit_bisect(probe_cubic, &params, p, step, &label);
+            fprintf(stderr, "Percollation limit: %1.5f\n", p);
+        break;
+        default:
+            p = find_limit_linear(probe_cubic, &params, p, step, &label);
+            fprintf(stderr, "Percollation limit: %1.5f\n", p);
+        break;
     }
-    free(labels);
 done:
+    cubic_free(params.cubic);
     return retval;
 }
 
-int fill_grid(gsl_matrix * matrix, double fill_probability)
+/*
+ * Single Newman-Ziff realization. Writes number of occupied sites, fill
+ * probability and largest cluster size for every step of the sweep.
+ */
+int sweep_newman_ziff(size_t L, unsigned int seed)
 {
     int retval = GSL_SUCCESS;
-    size_t i, j, L;
-    if (matrix == NULL)
+    newman_ziff_t * nz = NULL;
+    uint32_t * largest = NULL;
+    rng_t rng;
+    size_t k, N = L * L, spanning_at = 0;
+
+    nz = newman_ziff_alloc(L);
+    largest = malloc(N * sizeof(uint32_t));
+    if (nz == NULL || largest == NULL)
     {
-        retval = GSL_FAILURE;
+        retval = GSL_ENOMEM;
         goto done;
     }
 
-    if (matrix->size1 != matrix->size2)
+    rng_seed(&rng, seed, 0);
+    retval = newman_ziff_run(nz, &rng, largest, &spanning_at);
+    if (retval != GSL_SUCCESS)
     {
-        fprintf(stderr, "Error: matrix should be square.\n");
-        retval = GSL_ERANGE;
         goto done;
     }
 
-    L = matrix->size1;
-
-    for (i = 0; i < L; ++i)
+    for (k = 0; k < N; ++k)
     {
-        for (j = 0; j < L; ++j)
-        {
-            double probability = (double)(rand()) / (double)(RAND_MAX);
-            if (probability < fill_probability)
-            {
-                gsl_matrix_set(matrix, i, j, 1);
-            }
-            else
-            {
-                gsl_matrix_set(matrix, i, j, 0);
-            }
-        }
+        printf("%lu %e %u\n", (unsigned long)(k + 1),
+               (double)(k + 1) / (double)N, largest[k]);
     }
 
+    fprintf(stderr, "Occupied sites at percollation: %lu\n",
+            (unsigned long)spanning_at);
+    fprintf(stderr, "Percollation limit: %1.5f\n",
+            (double)spanning_at / (double)N);
 done:
+    free(largest);
+    newman_ziff_free(nz);
     return retval;
 }
 
-static int hk_find(gsl_vector * labels, int x)
+/*
+ * Ensemble of Newman-Ziff realizations. Writes fill probability and
+ * percollation probability for every number of occupied sites.
+ */
+int sweep_ensemble(size_t L, unsigned int seed, size_t realizations,
+                   size_t threads, double width)
 {
-    int y = x;
-    while (gsl_vector_get(labels, y) != y)
+    int retval = GSL_SUCCESS;
+    ensemble_t * ensemble = NULL;
+    size_t k, N = L * L;
+
+    ensemble = ensemble_alloc(L);
+    if (ensemble == NULL)
     {
-        y = gsl_vector_get(labels, y);
+        retval = GSL_ENOMEM;
+        goto done;
     }
-    while (gsl_vector_get(labels, x) != x)
+
+    retval = ensemble_run(ensemble, realizations, threads, seed, width);
+    if (retval != GSL_SUCCESS)
     {
-        int z = gsl_vector_get(labels, x);
-        gsl_vector_set(labels, x, y);
-        x = z;
+        goto done;
     }
-    return y;
-}
 
-static int hk_union(gsl_vector * labels, int x, int y)
-{
-    int value = hk_find(labels, y);
-    gsl_vector_set(labels, hk_find(labels, x), hk_find(labels, y));
-    return value;
+    for (k = 0; k <= N; ++k)
+    {
+        printf("%e %e\n", (double)k / (double)N,
+               (double)ensemble->spanning[k] / (double)ensemble->realizations);
+    }
+
+    fprintf(stderr, "Realizations: %lu\n",
+            (unsigned long)ensemble->realizations);
+    fprintf(stderr, "Percollation limit: %1.5f\n", ensemble->mean);
+    fprintf(stderr, "Variance: %e\n", ensemble->variance);
+    fprintf(stderr, "Confidence interval width: %e\n",
+            ensemble_interval(ensemble));
+done:
+    ensemble_free(ensemble);
+    return retval;
 }
 
-int hoshen_kopelman(gsl_matrix * matrix)
+/*
+ * Checks whether grid with fill probability p percollates keeping only two
+ * rows in memory. Grid is the same one -F would produce with that seed.
+ */
+int check_stream(size_t L, double p, unsigned int seed)
 {
     int retval = GSL_SUCCESS;
-    size_t i, j, L, n, label = 0;
-
-    gsl_vector * labels  = NULL;
+    int percollates = 0;
+    size_t rows = 0;
+    stream_t * stream = stream_alloc(L);
 
-    if (matrix == NULL)
+    if (stream == NULL)
     {
-        retval = GSL_FAILURE;
+        retval = GSL_ENOMEM;
         goto done;
     }
 
-    if (matrix->size1 != matrix->size2)
+    retval = stream_percollates(stream, p, seed, &percollates, &rows);
+    if (retval != GSL_SUCCESS)
     {
-        fprintf(stderr, "Error: matrix should be square.\n");
-        retval = GSL_ERANGE;
         goto done;
     }
 
-    L = matrix->size1;
+    fprintf(stderr, "Percollates: %s\n", percollates ? "yes" : "no");
+    fprintf(stderr, "Rows processed: %lu\n", (unsigned long)rows);
+done:
+    stream_free(stream);
+    return retval;
+}
 
-    labels = gsl_vector_alloc(L * L + 1);
-    gsl_vector_set_all(labels, 0);
-    n = labels->size;
+/* Parses comma separated list of grid sizes */
+int parse_sizes(const char * list, size_t * sizes, size_t * count)
+{
+    const char * cursor = list;
+    unsigned long size;
+    int consumed;
 
-    for (i = 0; i < L; ++i)
+    *count = 0;
+    while (*cursor != '\0')
     {
-        for (j = 0; j < L; ++j)
+        if (*count == MAX_SIZES ||
+            1 != sscanf(cursor, "%lu%n", &size, &consumed) || size == 0)
         {
-            int up = 0, left = 0;
-            if (gsl_matrix_get(matrix, i, j) == 0)
-            {
-                continue;
-            }
-
-            up = (i == 0 ? 0 : gsl_matrix_get(matrix, i - 1, j));
-            left = (j == 0 ? 0 : gsl_matrix_get(matrix, i, j - 1));
-
-            switch (!!up + !!left)
-            {
-                case 0:
-                    label = gsl_vector_get(labels, 0);
-                    gsl_vector_set(labels, 0, ++label);
-                    gsl_vector_set(labels, label, label);
-                    gsl_matrix_set(matrix, i, j, label);
-                break;
-                case 1:
-                    gsl_matrix_set(matrix, i, j, (up > left ? up : left));
-                break;
-                case 2:
-                    gsl_matrix_set(matrix, i, j, hk_union(labels, up, left));
-                break;
-            }
+            return GSL_ERANGE;
         }
-    }
-
-    for (i = 0; i < L; ++i)
-    {
-        for (j = 0; j < L; ++j)
+        sizes[(*count)++] = size;
+        cursor += consumed;
+        if (*cursor == ',')
         {
-            if (gsl_matrix_get(matrix, i, j) == 0)
-            {
-                continue;
-            }
-
-            gsl_matrix_set(matrix, i, j,
-                hk_find(labels, gsl_matrix_get(matrix, i, j)));
+            ++cursor;
+        }
+        else if (*cursor != '\0')
+        {
+            return GSL_ERANGE;
         }
     }
-    gsl_vector_free(labels);
-done:
-    return retval;
+    return (*count == 0 ? GSL_ERANGE : GSL_SUCCESS);
 }
 
-int save_matrix(gsl_matrix * matrix)
+/*
+ * Finite-size scaling: writes size, number of realizations, mean threshold
+ * and its standard deviation for every size, then fitted limit and nu.
+ */
+int sweep_scaling(const size_t * sizes, size_t count, unsigned int seed,
+                  size_t realizations, size_t threads)
 {
     int retval = GSL_SUCCESS;
-    size_t i, j, L;
-    if (matrix == NULL)
+    scaling_t * scaling = scaling_alloc(sizes, count);
+    size_t s;
+
+    if (scaling == NULL)
     {
-        retval = GSL_FAILURE;
+        retval = GSL_ENOMEM;
         goto done;
     }
 
-    if (matrix->size1 != matrix->size2)
+    retval = scaling_run(scaling, realizations, threads, seed);
+    if (retval == GSL_EDOM)
+    {
+        fprintf(stderr, "Error: threshold does not vary for some size, nu cannot be fitted.\n");
+    }
+    if (retval != GSL_SUCCESS)
     {
-        fprintf(stderr, "Error: matrix should be square.\n");
-        retval = GSL_ERANGE;
         goto done;
     }
 
-    L = matrix->size1;
+    for (s = scaling->count; s > 0; --s)
+    {
+        printf("%lu %lu %e %e\n", (unsigned long)scaling->sizes[s - 1],
+               (unsigned long)scaling->realizations[s - 1],
+               scaling->mean[s - 1], sqrt(scaling->variance[s - 1]));
+    }
+
+    fprintf(stderr, "Percollation limit: %1.5f +- %e\n",
+            scaling->limit, scaling->limit_error);
+    fprintf(stderr, "Nu: %f +- %f\n", scaling->nu, scaling->nu_error);
+done:
+    scaling_free(scaling);
+    return retval;
+}
+
+/*
+ * Flips random sites of grid filled with probability p, writes step, site,
+ * its new state and whether grid percollates after every flip.
+ */
+int run_flips(lattice_t * lattice, double p, unsigned int seed,
+              size_t flips, size_t threads)
+{
+    int retval = GSL_SUCCESS;
+    dynamic_t * dynamic = NULL;
+    size_t k, site, L = lattice->L, spanning = 0;
+    rng_t rng;
+
+    hosheen_kopelman_merged_parallel(lattice, p, seed, threads);
+    dynamic = dynamic_alloc(lattice);
+    if (dynamic == NULL)
+    {
+        retval = GSL_ENOMEM;
+        goto done;
+    }
 
-    for (i = 0; i < L; ++i)
+    rng_seed(&rng, seed, 0);
+    for (k = 0; k < flips; ++k)
     {
-        for (j = 0; j < L; ++j)
+        site = rng_index(&rng, L * L);
+        retval = dynamic_flip(dynamic, site / L, site % L);
+        if (retval != GSL_SUCCESS)
         {
-            printf("%2d ", (int)gsl_matrix_get(matrix, i, j));
+            goto done;
         }
-        printf("\n");
+
+        spanning += (dynamic->spanning != 0);
+        printf("%lu %lu %lu %d %d\n", (unsigned long)(k + 1),
+               (unsigned long)(site / L), (unsigned long)(site % L),
+               dynamic_is_occupied(dynamic, site / L, site % L),
+               dynamic->spanning != 0);
     }
+
+    fprintf(stderr, "Percollating after flips: %lu of %lu\n",
+            (unsigned long)spanning, (unsigned long)flips);
 done:
+    dynamic_free(dynamic);
     return retval;
 }
 
-int hosheen_kopelman_merged(gsl_matrix * matrix, double fill_probability)
+/* Prints chemical distance, backbone and dangling ends of spanning cluster */
+int analyse_cluster(lattice_t * lattice, int label)
 {
-int retval = GSL_SUCCESS;
-    size_t i, j, L, n, label = 0;
+    int retval = GSL_SUCCESS;
+    backbone_t * backbone = NULL;
 
-    gsl_vector * labels  = NULL;
+    if (label <= 0)
+    {
+        fprintf(stderr, "No spanning cluster to analyse.\n");
+        goto done;
+    }
 
-    if (matrix == NULL)
+    backbone = backbone_alloc(lattice->L);
+    if (backbone == NULL)
     {
-        retval = GSL_FAILURE;
+        retval = GSL_ENOMEM;
         goto done;
     }
 
-    if (matrix->size1 != matrix->size2)
+    retval = backbone_analyse(backbone, lattice, (uint32_t)label);
+    if (retval != GSL_SUCCESS)
     {
-        fprintf(stderr, "Error: matrix should be square.\n");
-        retval = GSL_ERANGE;
         goto done;
     }
 
-    L = matrix->size1;
+    fprintf(stderr, "Chemical distance: %lu\n",
+            (unsigned long)backbone->chemical_distance);
+    fprintf(stderr, "Spanning cluster mass: %lu\n",
+            (unsigned long)backbone->mass);
+    fprintf(stderr, "Backbone mass: %lu\n", (unsigned long)backbone->backbone);
+    fprintf(stderr, "Dangling ends mass: %lu\n",
+            (unsigned long)backbone->dangling);
+done:
+    backbone_free(backbone);
+    return retval;
+}
+
+void print_cluster_stats(const cluster_stats_t * stats, int verbose)
+{
+    size_t b;
+
+    fprintf(stderr, "Clusters: %lu\n", (unsigned long)stats->clusters);
+    fprintf(stderr, "Largest cluster: %u\n", stats->largest);
+    fprintf(stderr, "Mean cluster size: %f\n", stats->mean);
+    fprintf(stderr, "Weighted mean cluster size: %f\n", stats->weighted_mean);
 
-    labels = gsl_vector_alloc(L * L + 1);
-    gsl_vector_set_all(labels, 0);
-    n = labels->size;
+    if (!verbose)
+    {
+        return;
+    }
 
-    for (i = 0; i < L; ++i)
+    fprintf(stderr, "# Cluster size histogram (sizes in [2^b, 2^(b+1)))\n");
+    for (b = 0; b < LATTICE_HISTOGRAM_BINS; ++b)
     {
-        for (j = 0; j < L; ++j)
+        if (stats->histogram[b] != 0)
         {
-            int up = 0, left = 0;
-
-            double probability = (double)(rand()) / (double)(RAND_MAX);
-            if (probability < fill_probability)
-            {
-                gsl_matrix_set(matrix, i, j, 1);
-            }
-            else
-            {
-                gsl_matrix_set(matrix, i, j, 0);
-                continue;
-            }
-
-            up = (i == 0 ? 0 : gsl_matrix_get(matrix, i - 1, j));
-            left = (j == 0 ? 0 : gsl_matrix_get(matrix, i, j - 1));
-
-            switch (!!up + !!left)
-            {
-                case 0:
-                    label = gsl_vector_get(labels, 0);
-                    gsl_vector_set(labels, 0, ++label);
-                    gsl_vector_set(labels, label, label);
-                    gsl_matrix_set(matrix, i, j, label);
-                break;
-                case 1:
-                    gsl_matrix_set(matrix, i, j, (up > left ? up : left));
-                break;
-                case 2:
-                    gsl_matrix_set(matrix, i, j, hk_union(labels, up, left));
-                break;
-            }
+            fprintf(stderr, "%lu %lu\n", (unsigned long)b,
+                    (unsigned long)stats->histogram[b]);
         }
     }
+}
 
-    for (i = 0; i < L; ++i)
+int store_matrix(lattice_t * lattice, int format)
+{
+    if (format == FORMAT_RLE)
     {
-        for (j = 0; j < L; ++j)
-        {
-            if (gsl_matrix_get(matrix, i, j) == 0)
-            {
-                continue;
-            }
+        return save_matrix_rle(lattice, stdout);
+    }
+    return save_matrix(lattice);
+}
 
-            gsl_matrix_set(matrix, i, j,
-                hk_find(labels, gsl_matrix_get(matrix, i, j)));
-        }
+/* Converts run-length encoded grid to text matrix for plotting */
+int decode_file(const char * input_name)
+{
+    int retval = GSL_SUCCESS;
+    FILE * input = fopen(input_name, "rb");
+
+    if (input == NULL)
+    {
+        fprintf(stderr, "Error: could not open file %s\n", input_name);
+        retval = GSL_FAILURE;
+        goto done;
     }
-    gsl_vector_free(labels);
+
+    retval = decode_matrix_rle(input, stdout);
+    fclose(input);
 done:
     return retval;
 }
 
-/* "f:hp:vL:" */
+/* "ab:d:e:f:hi:l:m:n:o:p:s:t:vw:FL:" */
 void print_usage()
 {
     printf("OVERVIEW: Percollation theory 2D model.\n\n");
     printf("USAGE: percollation [options]\n\n");
     printf("OPTIONS:\n");
+    printf("  -a             Analyse spanning cluster: chemical distance, backbone and dangling ends mass. Open boundaries only.\n");
+    printf("  -b <boundary>  Boundary conditions: open (top to bottom spanning) or periodic with cluster wrapping horizontal, vertical, both or either direction. Default is open.\n");
+    printf("  -d <value>     Lattice dimension: 2 (square) or 3 (cubic, spanning along z). Default is %d.\n", OPTION_DEFAULT_DIMENSION);
+    printf("  -e <value>     Step of linear search or precision of bisection. Default is %e.\n", DEFAULT_STEP);
     printf("  -f <file>      Output file. Default is " OPTION_DEFAULT_FILE ".\n");
     printf("  -h             Print this message.\n");
+    printf("  -i <file>      Run-length encoded grid to decode.\n");
+    printf("  -l <list>      Comma separated grid sizes for scaling and bench modes. Default is -L value.\n");
+    printf("  -m <mode>      Percollation limit search mode: linear, bisect, nz (Newman-Ziff sweep), ensemble, scaling (sizes from -l), flip (-n random site flips at -p), bench (kernel timings for sizes from -l), stream (two-row check at -p) or decode (-i file to text). Default is " OPTION_DEFAULT_MODE ".\n");
+    printf("  -n <value>     Number of ensemble realizations or site flips. Default is %lu.\n", OPTION_DEFAULT_REALIZATIONS);
+    printf("  -o <format>    Output format: text or rle for grid, csv or json for bench. Default is text (csv for bench).\n");
     printf("  -p <value>     Fill probability. Default is %f.\n", OPTION_DEFAULT_FILL_PROBABILTY);
+    printf("  -s <value>     Random seed. Default is current time.\n");
+    printf("  -t <value>     Number of labelling or ensemble threads. Default is %lu.\n", OPTION_DEFAULT_THREADS);
     printf("  -v             Verbose mode.\n");
+    printf("  -w <value>     Stop ensemble when 95%% confidence interval is narrower. Default is %f (never).\n", OPTION_DEFAULT_WIDTH);
     printf("  -F             Force save grid without calculating percollation limit.\n");
     printf("  -L <value>     Grid Size. Default is %lu.\n", OPTION_DEFAULT_GRID_SIZE);
 }
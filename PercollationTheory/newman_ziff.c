@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "lattice.h"
+#include "newman_ziff.h"
+
+#define EDGE_TOP                (1)
+#define EDGE_BOTTOM             (2)
+#define EDGE_BOTH               (EDGE_TOP | EDGE_BOTTOM)
+
+newman_ziff_t * newman_ziff_alloc(size_t L)
+{
+    newman_ziff_t * nz = NULL;
+
+    if (L == 0 || L > UINT32_MAX / L)
+    {
+        fprintf(stderr, "Error: bad grid size %lu.\n", (unsigned long)L);
+        goto done;
+    }
+
+    nz = calloc(1, sizeof(newman_ziff_t));
+    if (nz == NULL)
+    {
+        goto done;
+    }
+
+    nz->L = L;
+    nz->capacity = L;
+    nz->parent = malloc(L * L * sizeof(uint32_t));
+    nz->size = malloc(L * L * sizeof(uint32_t));
+    nz->order = malloc(L * L * sizeof(uint32_t));
+    nz->edges = malloc(L * L * sizeof(uint8_t));
+
+    if (nz->parent == NULL || nz->size == NULL || nz->order == NULL ||
+        nz->edges == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate %lux%lu grid.\n",
+                (unsigned long)L, (unsigned long)L);
+        newman_ziff_free(nz);
+        nz = NULL;
+    }
+done:
+    return nz;
+}
+
+void newman_ziff_free(newman_ziff_t * nz)
+{
+    if (nz == NULL)
+    {
+        return;
+    }
+
+    free(nz->parent);
+    free(nz->size);
+    free(nz->order);
+    free(nz->edges);
+    free(nz);
+}
+
+int newman_ziff_resize(newman_ziff_t * nz, size_t L)
+{
+    if (nz == NULL || L == 0 || L > nz->capacity)
+    {
+        return GSL_EINVAL;
+    }
+
+    nz->L = L;
+    return GSL_SUCCESS;
+}
+
+/*
+ * Occupies all sites in random order drawn from rng. After n sites are
+ * occupied, largest cluster size is stored to largest[n - 1] (largest may be
+ * NULL). Number of occupied sites at which top and bottom rows got connected
+ * is stored to spanning_at.
+ */
+int newman_ziff_run(newman_ziff_t * nz, rng_t * rng, uint32_t * largest,
+                    size_t * spanning_at)
+{
+    int retval = GSL_SUCCESS;
+    size_t k, L, N;
+    uint32_t biggest = 0;
+
+    if (nz == NULL || rng == NULL || spanning_at == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    L = nz->L;
+    N = L * L;
+    *spanning_at = 0;
+
+    /* Fisher-Yates shuffle of site indices */
+    for (k = 0; k < N; ++k)
+    {
+        nz->order[k] = k;
+    }
+    for (k = N - 1; k > 0; --k)
+    {
+        size_t m = rng_index(rng, k + 1);
+        uint32_t tmp = nz->order[k];
+        nz->order[k] = nz->order[m];
+        nz->order[m] = tmp;
+    }
+
+    memset(nz->size, 0, N * sizeof(uint32_t));
+
+    for (k = 0; k < N; ++k)
+    {
+        uint32_t site = nz->order[k];
+        uint32_t neighbours[4], root = site;
+        size_t row = site / L, column = site % L, m, count = 0;
+
+        nz->parent[site] = site;
+        nz->size[site] = 1;
+        nz->edges[site] = (row == 0 ? EDGE_TOP : 0) |
+                          (row == L - 1 ? EDGE_BOTTOM : 0);
+
+        if (row > 0)
+        {
+            neighbours[count++] = site - L;
+        }
+        if (row < L - 1)
+        {
+            neighbours[count++] = site + L;
+        }
+        if (column > 0)
+        {
+            neighbours[count++] = site - 1;
+        }
+        if (column < L - 1)
+        {
+            neighbours[count++] = site + 1;
+        }
+
+        for (m = 0; m < count; ++m)
+        {
+            uint32_t other;
+            if (nz->size[neighbours[m]] == 0)
+            {
+                continue;
+            }
+
+            other = hk_find(nz->parent, neighbours[m]);
+            if (other != root)
+            {
+                uint32_t merged = hk_union(nz->parent, root, other);
+                nz->size[merged] = nz->size[root] + nz->size[other];
+                nz->edges[merged] = nz->edges[root] | nz->edges[other];
+                root = merged;
+            }
+        }
+
+        if (nz->size[root] > biggest)
+        {
+            biggest = nz->size[root];
+        }
+        if (largest != NULL)
+        {
+            largest[k] = biggest;
+        }
+        if (*spanning_at == 0 && nz->edges[root] == EDGE_BOTH)
+        {
+            *spanning_at = k + 1;
+        }
+    }
+done:
+    return retval;
+}
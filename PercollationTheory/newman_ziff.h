@@ -0,0 +1,33 @@
+#ifndef NEWMAN_ZIFF_H
+#define NEWMAN_ZIFF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rng.h"
+
+/*
+ * Workspace for Newman-Ziff algorithm: sites of L x L grid are occupied one
+ * by one in random order and merged into clusters with the same union-find
+ * used by Hoshen-Kopelman labelling. Site k is stored at index k, empty sites
+ * have zero size. Workspace allocated for some size can be reused for any
+ * smaller grid.
+ */
+typedef struct newman_ziff_s
+{
+    size_t     L;
+    size_t     capacity;
+    uint32_t * parent;
+    uint32_t * size;
+    uint32_t * order;
+    uint8_t  * edges;
+} newman_ziff_t;
+
+newman_ziff_t * newman_ziff_alloc(size_t L);
+void newman_ziff_free(newman_ziff_t * nz);
+int newman_ziff_resize(newman_ziff_t * nz, size_t L);
+
+int newman_ziff_run(newman_ziff_t * nz, rng_t * rng, uint32_t * largest,
+                    size_t * spanning_at);
+
+#endif
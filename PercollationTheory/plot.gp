@@ -17,4 +17,10 @@ set yrange [-1:]
 set grid
 set palette model CMY rgbformulae 7,5,15
 
-plot "data.dat" matrix with image
+# Run-length encoded grid (-o rle) is decoded on the fly:
+#   gnuplot -e 'rle="data.rle"' plot.gp
+if (exists("rle")) {
+    plot sprintf("< ./percollation -m decode -i %s -f /dev/stdout", rle) matrix with image
+} else {
+    plot "data.dat" matrix with image
+}
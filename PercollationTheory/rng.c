@@ -0,0 +1,134 @@
+#include "rng.h"
+
+#define ROTL(x, k)              (((x) << (k)) | ((x) >> (64 - (k))))
+
+static uint64_t splitmix64(uint64_t * x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ul);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ul;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBul;
+    return z ^ (z >> 31);
+}
+
+/*
+ * Streams with different numbers start from unrelated states, so
+ * realization k of an ensemble may use stream k whichever thread runs it
+ */
+void rng_seed(rng_t * rng, uint64_t seed, uint64_t stream)
+{
+    uint64_t x = seed;
+    uint64_t y = splitmix64(&x) ^ stream;
+    int i;
+
+    for (i = 0; i < 4; ++i)
+    {
+        rng->s[i] = splitmix64(&y);
+    }
+}
+
+uint64_t rng_next(rng_t * rng)
+{
+    uint64_t * s = rng->s;
+    uint64_t result = ROTL(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = ROTL(s[3], 45);
+
+    return result;
+}
+
+/* Uniform number in [0, 1) with 53 random bits */
+double rng_uniform(rng_t * rng)
+{
+    return (double)(rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Uniform index in [0, n) */
+uint64_t rng_index(rng_t * rng, uint64_t n)
+{
+    uint64_t limit = -n % n;
+    uint64_t x;
+
+    /* Rejection removes modulo bias */
+    do
+    {
+        x = rng_next(rng);
+    } while (x < limit);
+
+    return x % n;
+}
+
+#define PHILOX_M0               (0xD2511F53u)
+#define PHILOX_M1               (0xCD9E8D57u)
+#define PHILOX_W0               (0x9E3779B9u)
+#define PHILOX_W1               (0xBB67AE85u)
+#define PHILOX_ROUNDS           (10)
+/* Blocks per 64-bit occupancy word */
+#define PHILOX_BLOCKS           (64 / PHILOX_LANES)
+
+/* Site is occupied when its 32-bit random number is below threshold */
+uint64_t philox_threshold(double probability)
+{
+    if (probability <= 0)
+    {
+        return 0;
+    }
+    if (probability >= 1)
+    {
+        return (uint64_t)1 << 32;
+    }
+    return (uint64_t)(probability * 4294967296.0);
+}
+
+/*
+ * Occupancy bits of sites [64 * word, 64 * word + 64) in given row. All 16
+ * Philox blocks of the word are computed lane by lane in plain arrays, which
+ * lets compiler vectorize rounds across blocks.
+ */
+uint64_t philox_occupancy(uint64_t key, uint64_t row, uint64_t word,
+                          uint64_t threshold)
+{
+    uint32_t c0[PHILOX_BLOCKS], c1[PHILOX_BLOCKS];
+    uint32_t c2[PHILOX_BLOCKS], c3[PHILOX_BLOCKS];
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    uint64_t bits = 0;
+    int b, r;
+
+    for (b = 0; b < PHILOX_BLOCKS; ++b)
+    {
+        c0[b] = (uint32_t)(word * PHILOX_BLOCKS + b);
+        c1[b] = (uint32_t)row;
+        c2[b] = (uint32_t)(row >> 32);
+        c3[b] = (uint32_t)(word >> 28);
+    }
+
+    for (r = 0; r < PHILOX_ROUNDS; ++r)
+    {
+        for (b = 0; b < PHILOX_BLOCKS; ++b)
+        {
+            uint64_t p0 = (uint64_t)PHILOX_M0 * c0[b];
+            uint64_t p1 = (uint64_t)PHILOX_M1 * c2[b];
+            uint32_t t1 = c1[b], t3 = c3[b];
+            c0[b] = (uint32_t)(p1 >> 32) ^ t1 ^ k0;
+            c2[b] = (uint32_t)(p0 >> 32) ^ t3 ^ k1;
+            c1[b] = (uint32_t)p1;
+            c3[b] = (uint32_t)p0;
+        }
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    for (b = 0; b < PHILOX_BLOCKS; ++b)
+    {
+        bits |= (uint64_t)(c0[b] < threshold) << (PHILOX_LANES * b);
+        bits |= (uint64_t)(c1[b] < threshold) << (PHILOX_LANES * b + 1);
+        bits |= (uint64_t)(c2[b] < threshold) << (PHILOX_LANES * b + 2);
+        bits |= (uint64_t)(c3[b] < threshold) << (PHILOX_LANES * b + 3);
+    }
+    return bits;
+}
@@ -0,0 +1,30 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*
+ * Small xoshiro256** generator. Unlike rand() it has no hidden global
+ * state, so every thread can own an independent stream.
+ */
+typedef struct rng_s
+{
+    uint64_t s[4];
+} rng_t;
+
+void rng_seed(rng_t * rng, uint64_t seed, uint64_t stream);
+uint64_t rng_next(rng_t * rng);
+double rng_uniform(rng_t * rng);
+uint64_t rng_index(rng_t * rng, uint64_t n);
+
+/*
+ * Counter-based Philox4x32-10 generator. Output depends only on key and
+ * counter, so any part of the grid can be generated independently.
+ */
+#define PHILOX_LANES            (4)
+
+uint64_t philox_threshold(double probability);
+uint64_t philox_occupancy(uint64_t key, uint64_t row, uint64_t word,
+                          uint64_t threshold);
+
+#endif
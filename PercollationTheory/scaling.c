@@ -0,0 +1,298 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_fit.h>
+#include <gsl/gsl_nan.h>
+
+#include "newman_ziff.h"
+#include "rng.h"
+#include "scaling.h"
+
+/*
+ * State shared by worker threads, guarded by lock. results[task] is the
+ * spanning site count of task, every task writes only its own entry.
+ */
+typedef struct scaling_pool_s
+{
+    scaling_t *     scaling;
+    pthread_mutex_t lock;
+    size_t          next;
+    size_t          per_size;
+    unsigned int    seed;
+    size_t *        results;
+    int             error;
+} scaling_pool_t;
+
+static int compare_sizes(const void * a, const void * b)
+{
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return (x < y) - (x > y);
+}
+
+/*
+ * Sizes are kept in descending order, so the biggest grids start first.
+ * Repeated sizes are merged, they would only weight one point of the fit.
+ */
+scaling_t * scaling_alloc(const size_t * sizes, size_t count)
+{
+    scaling_t * scaling = NULL;
+    size_t s, unique;
+
+    if (sizes == NULL || count == 0)
+    {
+        goto done;
+    }
+
+    scaling = calloc(1, sizeof(scaling_t));
+    if (scaling == NULL)
+    {
+        goto done;
+    }
+
+    scaling->count = count;
+    scaling->sizes = malloc(count * sizeof(size_t));
+    scaling->realizations = calloc(count, sizeof(size_t));
+    scaling->mean = calloc(count, sizeof(double));
+    scaling->variance = calloc(count, sizeof(double));
+
+    if (scaling->sizes == NULL || scaling->realizations == NULL ||
+        scaling->mean == NULL || scaling->variance == NULL)
+    {
+        scaling_free(scaling);
+        scaling = NULL;
+        goto done;
+    }
+
+    memcpy(scaling->sizes, sizes, count * sizeof(size_t));
+    qsort(scaling->sizes, count, sizeof(size_t), compare_sizes);
+    for (s = 1, unique = 1; s < count; ++s)
+    {
+        if (scaling->sizes[s] != scaling->sizes[unique - 1])
+        {
+            scaling->sizes[unique++] = scaling->sizes[s];
+        }
+    }
+    scaling->count = unique;
+done:
+    return scaling;
+}
+
+void scaling_free(scaling_t * scaling)
+{
+    if (scaling == NULL)
+    {
+        return;
+    }
+
+    free(scaling->sizes);
+    free(scaling->realizations);
+    free(scaling->mean);
+    free(scaling->variance);
+    free(scaling);
+}
+
+/*
+ * Every worker allocates one Newman-Ziff workspace for the biggest size and
+ * shrinks it for smaller ones. Realization k of size index s uses random
+ * stream s * 2^32 + k.
+ */
+static void * scaling_worker(void * arg)
+{
+    scaling_pool_t * pool = arg;
+    scaling_t * scaling = pool->scaling;
+    size_t total = scaling->count * pool->per_size;
+    newman_ziff_t * nz = newman_ziff_alloc(scaling->sizes[0]);
+    rng_t rng;
+
+    if (nz == NULL)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->error = GSL_ENOMEM;
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+
+    for (;;)
+    {
+        size_t task, s, k, L, spanning_at = 0;
+
+        pthread_mutex_lock(&pool->lock);
+        if (pool->error != GSL_SUCCESS || pool->next >= total)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        task = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        s = task / pool->per_size;
+        k = task % pool->per_size;
+        L = scaling->sizes[s];
+
+        newman_ziff_resize(nz, L);
+        rng_seed(&rng, pool->seed, ((uint64_t)s << 32) | k);
+        newman_ziff_run(nz, &rng, NULL, &spanning_at);
+        pool->results[task] = spanning_at;
+    }
+
+    newman_ziff_free(nz);
+    return NULL;
+}
+
+/*
+ * Welford mean and variance of every size, taken in realization order
+ * after all workers are joined, so the sums do not depend on scheduling
+ */
+static void scaling_reduce(scaling_t * scaling, const size_t * results,
+                           size_t per_size)
+{
+    size_t s, k;
+
+    for (s = 0; s < scaling->count; ++s)
+    {
+        double N = (double)scaling->sizes[s] * (double)scaling->sizes[s];
+        double m2 = 0;
+
+        scaling->realizations[s] = 0;
+        scaling->mean[s] = 0;
+        for (k = 0; k < per_size; ++k)
+        {
+            double threshold = (double)results[s * per_size + k] / N;
+            double delta = threshold - scaling->mean[s];
+            scaling->realizations[s]++;
+            scaling->mean[s] += delta / (double)scaling->realizations[s];
+            m2 += delta * (threshold - scaling->mean[s]);
+        }
+        scaling->variance[s] = (scaling->realizations[s] > 1 ?
+            m2 / (double)(scaling->realizations[s] - 1) : 0);
+    }
+}
+
+/*
+ * Fits log(std) = c - log(L) / nu, then mean = limit + a * L^(-1/nu).
+ * Errors are left NaN when there are too few sizes to estimate them. Zero
+ * variance of any size has no logarithm, so it gives GSL_EDOM.
+ */
+static int scaling_fit(scaling_t * scaling)
+{
+    int retval = GSL_SUCCESS;
+    size_t s, n = scaling->count;
+    double * x = NULL, * y = NULL;
+    double c0, c1, cov00, cov01, cov11, sumsq;
+
+    scaling->limit_error = scaling->nu_error = GSL_NAN;
+    if (n < 2)
+    {
+        scaling->limit = (n == 1 ? scaling->mean[0] : GSL_NAN);
+        scaling->nu = GSL_NAN;
+        goto done;
+    }
+
+    x = malloc(n * sizeof(double));
+    y = malloc(n * sizeof(double));
+    if (x == NULL || y == NULL)
+    {
+        retval = GSL_ENOMEM;
+        goto done;
+    }
+
+    for (s = 0; s < n; ++s)
+    {
+        if (!(scaling->variance[s] > 0))
+        {
+            scaling->limit = scaling->nu = GSL_NAN;
+            retval = GSL_EDOM;
+            goto done;
+        }
+    }
+
+    for (s = 0; s < n; ++s)
+    {
+        x[s] = log((double)scaling->sizes[s]);
+        y[s] = 0.5 * log(scaling->variance[s]);
+    }
+    gsl_fit_linear(x, 1, y, 1, n, &c0, &c1, &cov00, &cov01, &cov11, &sumsq);
+    scaling->nu = -1.0 / c1;
+    if (n > 2)
+    {
+        scaling->nu_error = sqrt(cov11) / (c1 * c1);
+    }
+
+    for (s = 0; s < n; ++s)
+    {
+        x[s] = pow((double)scaling->sizes[s], -1.0 / scaling->nu);
+        y[s] = scaling->mean[s];
+    }
+    gsl_fit_linear(x, 1, y, 1, n, &c0, &c1, &cov00, &cov01, &cov11, &sumsq);
+    scaling->limit = c0;
+    if (n > 2)
+    {
+        scaling->limit_error = sqrt(cov00);
+    }
+done:
+    free(x);
+    free(y);
+    return retval;
+}
+
+int scaling_run(scaling_t * scaling, size_t realizations, size_t threads,
+                unsigned int seed)
+{
+    int retval = GSL_SUCCESS;
+    size_t t, started;
+    pthread_t * workers = NULL;
+    scaling_pool_t pool;
+
+    memset(&pool, 0, sizeof(pool));
+
+    if (scaling == NULL || realizations == 0 || threads == 0)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    pool.scaling = scaling;
+    pool.per_size = realizations;
+    pool.seed = seed;
+    pool.results = malloc(scaling->count * realizations * sizeof(size_t));
+    workers = malloc(threads * sizeof(pthread_t));
+    if (pool.results == NULL || workers == NULL)
+    {
+        retval = GSL_ENOMEM;
+        goto done;
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    for (started = 0; started < threads; ++started)
+    {
+        if (0 != pthread_create(&workers[started], NULL, scaling_worker,
+                                &pool))
+        {
+            fprintf(stderr, "Error: could not start scaling thread.\n");
+            break;
+        }
+    }
+    for (t = 0; t < started; ++t)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    pthread_mutex_destroy(&pool.lock);
+
+    retval = (started == 0 ? GSL_FAILURE : pool.error);
+    if (retval != GSL_SUCCESS)
+    {
+        goto done;
+    }
+
+    scaling_reduce(scaling, pool.results, pool.per_size);
+    retval = scaling_fit(scaling);
+done:
+    free(pool.results);
+    free(workers);
+    return retval;
+}
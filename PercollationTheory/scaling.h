@@ -0,0 +1,31 @@
+#ifndef SCALING_H
+#define SCALING_H
+
+#include <stddef.h>
+
+/*
+ * Finite-size scaling over several grid sizes. For every size mean and
+ * variance of Newman-Ziff threshold estimates are collected, then
+ * std(L) ~ L^(-1/nu) gives nu and mean(L) = limit + a * L^(-1/nu) gives
+ * the infinite grid limit.
+ */
+typedef struct scaling_s
+{
+    size_t   count;
+    size_t * sizes;
+    size_t * realizations;
+    double * mean;
+    double * variance;
+    double   limit;
+    double   limit_error;
+    double   nu;
+    double   nu_error;
+} scaling_t;
+
+scaling_t * scaling_alloc(const size_t * sizes, size_t count);
+void scaling_free(scaling_t * scaling);
+
+int scaling_run(scaling_t * scaling, size_t realizations, size_t threads,
+                unsigned int seed);
+
+#endif
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "lattice.h"
+#include "rng.h"
+#include "stream.h"
+
+stream_t * stream_alloc(size_t L)
+{
+    stream_t * stream = NULL;
+    lattice_t * view;
+
+    if (L == 0 || L >= UINT32_MAX / 2)
+    {
+        fprintf(stderr, "Error: bad grid size %lu.\n", (unsigned long)L);
+        goto done;
+    }
+
+    stream = calloc(1, sizeof(stream_t));
+    if (stream == NULL)
+    {
+        goto done;
+    }
+
+    /* Previous row has at most ceil(L / 2) labels, current one adds as many */
+    view = &stream->view;
+    view->L = L;
+    view->row_words = (L + LATTICE_WORD_BITS - 1) / LATTICE_WORD_BITS;
+    view->parent_size = 2 * ((L + 1) / 2) + 1;
+
+    view->occupied = calloc(2 * view->row_words, sizeof(uint64_t));
+    view->labels = calloc(2 * L, sizeof(uint32_t));
+    view->parent = calloc(view->parent_size, sizeof(uint32_t));
+    view->sizes = calloc(view->parent_size, sizeof(uint32_t));
+    stream->remap = calloc(view->parent_size, sizeof(uint32_t));
+    stream->top = calloc(view->parent_size, sizeof(uint8_t));
+    stream->next_top = calloc(view->parent_size, sizeof(uint8_t));
+
+    if (view->occupied == NULL || view->labels == NULL ||
+        view->parent == NULL || view->sizes == NULL ||
+        stream->remap == NULL || stream->top == NULL ||
+        stream->next_top == NULL)
+    {
+        stream_free(stream);
+        stream = NULL;
+    }
+done:
+    return stream;
+}
+
+void stream_free(stream_t * stream)
+{
+    if (stream == NULL)
+    {
+        return;
+    }
+
+    free(stream->view.occupied);
+    free(stream->view.labels);
+    free(stream->view.parent);
+    free(stream->view.sizes);
+    free(stream->remap);
+    free(stream->top);
+    free(stream->next_top);
+    free(stream);
+}
+
+/* Generates grid row i into row 1 of the view, same bits as fill_grid */
+static void stream_fill_row(lattice_t * view, uint64_t i, uint64_t seed,
+                            uint64_t threshold)
+{
+    uint64_t * row = view->occupied + view->row_words;
+    size_t w, tail = view->L % LATTICE_WORD_BITS;
+
+    for (w = 0; w < view->row_words; ++w)
+    {
+        row[w] = philox_occupancy(seed, i, w, threshold);
+    }
+    if (tail != 0)
+    {
+        row[view->row_words - 1] &= ((uint64_t)1 << tail) - 1;
+    }
+}
+
+/*
+ * Labels L x L grid (same as fill_grid with the same seed would produce)
+ * one row at a time. After every row all labels are replaced with their
+ * roots renumbered from 1, so union-find never grows beyond O(L). Stops
+ * early once no cluster connected to the top row survives. rows gets number
+ * of processed rows.
+ */
+int stream_percollates(stream_t * stream, double fill_probability,
+                       uint64_t seed, int * percollates, size_t * rows)
+{
+    int retval = GSL_SUCCESS;
+    size_t i, j, L;
+    uint64_t threshold = philox_threshold(fill_probability);
+    uint32_t live = 0;
+    lattice_t * view;
+
+    if (stream == NULL || percollates == NULL)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    view = &stream->view;
+    L = view->L;
+    *percollates = 0;
+
+    for (i = 0; i < L; ++i)
+    {
+        uint32_t * previous = view->labels;
+        uint32_t * current = view->labels + L;
+        uint32_t * parent = view->parent;
+        uint32_t k, used = live, alive = 0;
+        uint8_t * swap;
+
+        for (k = 1; k <= live; ++k)
+        {
+            parent[k] = k;
+            view->sizes[k] = 0;
+        }
+
+        stream_fill_row(view, i, seed, threshold);
+        hk_label_row(view, 1, i != 0, &used);
+
+        /* Only labels created in the first row touch the top */
+        for (k = live + 1; k <= used; ++k)
+        {
+            stream->top[k] = (i == 0);
+        }
+        for (k = 1; k <= used; ++k)
+        {
+            uint32_t root = hk_find(parent, k);
+            stream->top[root] |= stream->top[k];
+            stream->remap[k] = 0;
+        }
+
+        /* Compact surviving clusters into 1..live */
+        live = 0;
+        for (j = 0; j < L; ++j)
+        {
+            uint32_t root;
+            if (current[j] == 0)
+            {
+                previous[j] = 0;
+                continue;
+            }
+
+            root = hk_find(parent, current[j]);
+            if (stream->remap[root] == 0)
+            {
+                stream->remap[root] = ++live;
+                stream->next_top[live] = stream->top[root];
+                alive |= stream->top[root];
+            }
+            previous[j] = stream->remap[root];
+        }
+
+        swap = stream->top;
+        stream->top = stream->next_top;
+        stream->next_top = swap;
+
+        if (!alive)
+        {
+            ++i;
+            break;
+        }
+        if (i == L - 1)
+        {
+            *percollates = 1;
+        }
+    }
+
+    if (rows != NULL)
+    {
+        *rows = i;
+    }
+done:
+    return retval;
+}
@@ -0,0 +1,29 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lattice.h"
+
+/*
+ * Row-by-row percollation check that keeps only two rows of the grid.
+ * view is a two-row lattice: row 0 holds previous row relabelled to
+ * 1..live, row 1 holds the row being labelled. top[k] tells whether label k
+ * is connected to the top row of the grid.
+ */
+typedef struct stream_s
+{
+    lattice_t  view;
+    uint32_t * remap;
+    uint8_t  * top;
+    uint8_t  * next_top;
+} stream_t;
+
+stream_t * stream_alloc(size_t L);
+void stream_free(stream_t * stream);
+
+int stream_percollates(stream_t * stream, double fill_probability,
+                       uint64_t seed, int * percollates, size_t * rows);
+
+#endif
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gsl/gsl_errno.h>
+
+#include "lattice.h"
+#include "torus.h"
+
+torus_t * torus_alloc(const lattice_t * lattice)
+{
+    torus_t * torus = NULL;
+
+    if (lattice == NULL)
+    {
+        goto done;
+    }
+
+    torus = calloc(1, sizeof(torus_t));
+    if (torus == NULL)
+    {
+        goto done;
+    }
+
+    torus->capacity = lattice->parent_size;
+    torus->parent = calloc(torus->capacity, sizeof(uint32_t));
+    torus->dx = calloc(torus->capacity, sizeof(int32_t));
+    torus->dy = calloc(torus->capacity, sizeof(int32_t));
+    torus->wraps = calloc(torus->capacity, sizeof(uint8_t));
+
+    if (torus->parent == NULL || torus->dx == NULL || torus->dy == NULL ||
+        torus->wraps == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate periodic boundaries.\n");
+        torus_free(torus);
+        torus = NULL;
+    }
+done:
+    return torus;
+}
+
+void torus_free(torus_t * torus)
+{
+    if (torus == NULL)
+    {
+        return;
+    }
+
+    free(torus->parent);
+    free(torus->dx);
+    free(torus->dy);
+    free(torus->wraps);
+    free(torus);
+}
+
+/*
+ * Finds root of x and its shift relative to root. Path is fully compressed,
+ * every node on it gets its own total shift.
+ */
+static uint32_t torus_find(torus_t * torus, uint32_t x, int32_t * dx,
+                           int32_t * dy)
+{
+    uint32_t root = x, next;
+    int32_t sx = 0, sy = 0, step_x, step_y;
+
+    while (torus->parent[root] != root)
+    {
+        sx += torus->dx[root];
+        sy += torus->dy[root];
+        root = torus->parent[root];
+    }
+    *dx = sx;
+    *dy = sy;
+
+    while (torus->parent[x] != root && x != root)
+    {
+        next = torus->parent[x];
+        step_x = torus->dx[x];
+        step_y = torus->dy[x];
+        torus->parent[x] = root;
+        torus->dx[x] = sx;
+        torus->dy[x] = sy;
+        sx -= step_x;
+        sy -= step_y;
+        x = next;
+    }
+    return root;
+}
+
+/*
+ * Links clusters a and b where b is met at shift (sx, sy) periods from a.
+ * Smaller label becomes root, so parent[x] <= x holds as in the lattice.
+ */
+static void torus_link(torus_t * torus, uint32_t a, uint32_t b, int32_t sx,
+                       int32_t sy)
+{
+    int32_t ax, ay, bx, by, wx, wy;
+    uint32_t ra = torus_find(torus, a, &ax, &ay);
+    uint32_t rb = torus_find(torus, b, &bx, &by);
+
+    /* Shift from image of b reached through border to b itself */
+    wx = ax + sx - bx;
+    wy = ay + sy - by;
+
+    if (ra == rb)
+    {
+        torus->wraps[ra] |= (wx != 0 ? TORUS_WRAP_HORIZONTAL : 0) |
+                            (wy != 0 ? TORUS_WRAP_VERTICAL : 0);
+        return;
+    }
+
+    if (ra < rb)
+    {
+        torus->parent[rb] = ra;
+        torus->dx[rb] = wx;
+        torus->dy[rb] = wy;
+        torus->wraps[ra] |= torus->wraps[rb];
+    }
+    else
+    {
+        torus->parent[ra] = rb;
+        torus->dx[ra] = -wx;
+        torus->dy[ra] = -wy;
+        torus->wraps[rb] |= torus->wraps[ra];
+    }
+}
+
+/*
+ * Applies periodic boundaries to lattice labelled with open boundaries
+ * (any of hoshen_kopelman functions). Clusters touching across left-right
+ * and top-bottom borders are merged, labels, sizes and statistics are
+ * updated to the torus clusters.
+ */
+int hoshen_kopelman_torus(lattice_t * lattice, torus_t * torus)
+{
+    int retval = GSL_SUCCESS;
+    size_t i, L, n;
+    uint32_t k, used, merged = 0, last_a = 0, last_b = 0;
+    uint32_t * labels, * parent, * sizes;
+    int32_t dx, dy;
+
+    if (lattice == NULL || torus == NULL ||
+        torus->capacity < lattice->parent_size)
+    {
+        retval = GSL_FAILURE;
+        goto done;
+    }
+
+    L = lattice->L;
+    n = L * L;
+    labels = lattice->labels;
+    parent = lattice->parent;
+    sizes = lattice->sizes;
+    used = parent[0];
+
+    for (k = 1; k <= used; ++k)
+    {
+        torus->parent[k] = k;
+        torus->dx[k] = torus->dy[k] = 0;
+        torus->wraps[k] = 0;
+    }
+
+    /* Right border meets left one in the next period along x */
+    for (i = 0; i < L; ++i)
+    {
+        uint32_t a = labels[i * L + L - 1], b = labels[i * L];
+        if (a != 0 && b != 0 && (a != last_a || b != last_b))
+        {
+            torus_link(torus, a, b, 1, 0);
+            last_a = a;
+            last_b = b;
+        }
+    }
+
+    last_a = last_b = 0;
+    for (i = 0; i < L; ++i)
+    {
+        uint32_t a = labels[(L - 1) * L + i], b = labels[i];
+        if (a != 0 && b != 0 && (a != last_a || b != last_b))
+        {
+            torus_link(torus, a, b, 0, 1);
+            last_a = a;
+            last_b = b;
+        }
+    }
+
+    /* Torus roots are not greater than labels, one ascending pass is enough */
+    parent[0] = 0;
+    torus->wrapping = 0;
+    torus->wrapping_label = 0;
+    cluster_stats_reset(&lattice->stats);
+    for (k = 1; k <= used; ++k)
+    {
+        if (parent[k] == k)
+        {
+            parent[k] = torus_find(torus, k, &dx, &dy);
+            if (parent[k] != k)
+            {
+                sizes[parent[k]] += sizes[k];
+                merged = 1;
+            }
+        }
+        else
+        {
+            parent[k] = parent[parent[k]];
+        }
+    }
+
+    for (k = 1; k <= used; ++k)
+    {
+        if (parent[k] == k)
+        {
+            cluster_stats_add(&lattice->stats, k, sizes[k]);
+            if (torus->wraps[k] != 0 && torus->wrapping_label == 0)
+            {
+                torus->wrapping_label = k;
+            }
+            torus->wrapping |= torus->wraps[k];
+        }
+    }
+    cluster_stats_finish(&lattice->stats);
+
+    if (merged)
+    {
+        for (i = 0; i < n; ++i)
+        {
+            labels[i] = parent[labels[i]];
+        }
+    }
+    parent[0] = used;
+done:
+    return retval;
+}
@@ -0,0 +1,38 @@
+#ifndef TORUS_H
+#define TORUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lattice.h"
+
+#define TORUS_WRAP_HORIZONTAL   (1)
+#define TORUS_WRAP_VERTICAL     (2)
+#define TORUS_WRAP_BOTH         (TORUS_WRAP_HORIZONTAL | TORUS_WRAP_VERTICAL)
+
+/*
+ * Periodic boundaries on top of open-boundary labelling. Clusters found by
+ * Hoshen-Kopelman are nodes of second union-find where every node keeps
+ * its shift (dx, dy) relative to parent, counted in whole lattice periods.
+ * Merging across a border with a shift that disagrees with the one already
+ * known means the cluster winds around the torus. wraps[root] holds
+ * TORUS_WRAP_* flags of the cluster, wrapping and wrapping_label describe
+ * all wrapping directions and the first wrapping cluster of the last run.
+ */
+typedef struct torus_s
+{
+    size_t     capacity;
+    uint32_t * parent;
+    int32_t  * dx;
+    int32_t  * dy;
+    uint8_t  * wraps;
+    int        wrapping;
+    uint32_t   wrapping_label;
+} torus_t;
+
+torus_t * torus_alloc(const lattice_t * lattice);
+void torus_free(torus_t * torus);
+
+int hoshen_kopelman_torus(lattice_t * lattice, torus_t * torus);
+
+#endif